@@ -0,0 +1,289 @@
+// Host-side benchmark for the kernel heap in src/memory.c.
+//
+//   make bench                        run the synthetic traces
+//   build/heap_bench trace.txt ...    replay recorded traces
+//
+// Trace files hold one operation per line; ids name live pointers:
+//   a <id> <size>    malloc
+//   r <id> <size>    realloc
+//   f <id>           free
+//
+// Each trace runs in its own child process so every run starts from a
+// fresh heap. Latencies are per operation, with the clock overhead removed.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "memory.h"
+
+#define BENCH_MAX_OPS 1000000
+#define BENCH_MAX_LIVE 8192
+#define BENCH_BACKING_SIZE (256 * 1024 * 1024)
+#define BENCH_GROW_MIN (1024 * 1024)     // Same granularity as pmm_heap_grow
+#define BENCH_SAMPLE_EVERY 1024
+
+typedef struct {
+    char op;                             // 'a', 'r' or 'f'
+    unsigned int id;
+    size_t size;
+} bench_op_t;
+
+static bench_op_t ops[BENCH_MAX_OPS];
+static int op_count = 0;
+static uint32_t latency[BENCH_MAX_OPS];
+static void* live[BENCH_MAX_LIVE];
+
+// Memory the heap grows into, standing in for the page-frame allocator
+static unsigned char backing[BENCH_BACKING_SIZE] __attribute__((aligned(4096)));
+static size_t backing_used = 0;
+
+// Kernel symbols memory.c links against
+void shell_print_string(const char* str) {
+    (void)str;
+}
+
+char* itoa(int value, char* str) {
+    sprintf(str, "%d", value);
+    return str;
+}
+
+char* itoa_hex(uint32_t value, char* str) {
+    sprintf(str, "%X", value);
+    return str;
+}
+
+static void* bench_grow(size_t* bytes) {
+    size_t size = *bytes < BENCH_GROW_MIN ? BENCH_GROW_MIN : *bytes;
+    size = (size + 4095) & ~(size_t)4095;
+    if (backing_used + size > BENCH_BACKING_SIZE) return NULL;
+    
+    void* region = backing + backing_used;
+    backing_used += size;
+    *bytes = size;
+    return region;
+}
+
+// xorshift32, so traces are identical from run to run
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) {
+    return lo + rng() % (hi - lo + 1);
+}
+
+// Mostly small objects with a tail of large ones
+static size_t random_size(void) {
+    uint32_t r = rng() % 100;
+    if (r < 80) return rng_range(8, 256);
+    if (r < 95) return rng_range(257, 4096);
+    return rng_range(4097, 65536);
+}
+
+static void emit(char op, unsigned int id, size_t size) {
+    if (op_count >= BENCH_MAX_OPS) return;
+    ops[op_count].op = op;
+    ops[op_count].id = id;
+    ops[op_count].size = size;
+    op_count++;
+}
+
+// Random sizes and lifetimes over a fixed set of slots
+static void gen_random(int count) {
+    static char used[4096];
+    memset(used, 0, sizeof(used));
+    
+    for (int i = 0; i < count; i++) {
+        unsigned int id = rng() % 4096;
+        emit(used[id] ? 'f' : 'a', id, random_size());
+        used[id] = !used[id];
+    }
+}
+
+// FIFO lifetimes: a producer allocates messages that a consumer frees in
+// arrival order, in bursts so the queue length keeps changing
+static void gen_producer_consumer(int count) {
+    unsigned int head = 0;
+    unsigned int tail = 0;
+    const unsigned int ring = 4096;
+    
+    while (op_count < count) {
+        int burst = rng_range(1, 64);
+        for (int i = 0; i < burst && head - tail < ring; i++) {
+            emit('a', head % ring, rng_range(32, 2048));
+            head++;
+        }
+        burst = rng_range(1, 64);
+        for (int i = 0; i < burst && tail < head; i++) {
+            emit('f', tail % ring, 0);
+            tail++;
+        }
+    }
+}
+
+// Growing buffers, string-builder style, released once they get big
+static void gen_realloc_heavy(int count) {
+    static size_t size[256];
+    static size_t limit[256];
+    memset(size, 0, sizeof(size));
+    
+    while (op_count < count) {
+        unsigned int id = rng() % 256;
+        if (size[id] == 0) {
+            size[id] = rng_range(16, 128);
+            limit[id] = rng_range(16 * 1024, 64 * 1024);
+            emit('a', id, size[id]);
+        } else if (size[id] > limit[id]) {
+            emit('f', id, 0);
+            size[id] = 0;
+        } else {
+            size[id] += rng_range(16, 256);
+            emit('r', id, size[id]);
+        }
+    }
+}
+
+static int load_trace(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return 0;
+    }
+    
+    char op;
+    unsigned int id;
+    size_t size;
+    while (fscanf(file, " %c %u", &op, &id) == 2) {
+        size = 0;
+        if (op != 'f' && fscanf(file, " %zu", &size) != 1) break;
+        emit(op, id % BENCH_MAX_LIVE, size);
+    }
+    
+    fclose(file);
+    return 1;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// 1 - largest / free: 0 when all free memory is one block
+static double fragmentation(const memory_stats_t* stats) {
+    if (stats->free == 0) return 0.0;
+    return 1.0 - (double)stats->largest_free / (double)stats->free;
+}
+
+static void run_trace(const char* name) {
+    memory_init();
+    memory_set_grow_handler(bench_grow);
+    memset(live, 0, sizeof(live));
+    
+    // Cost of reading the clock, subtracted from every sample
+    uint64_t overhead = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = now_ns();
+        uint64_t t1 = now_ns();
+        if (t1 - t0 < overhead) overhead = t1 - t0;
+    }
+    
+    memory_stats_t stats;
+    double peak_frag = 0.0;
+    uint64_t total = 0;
+    
+    for (int i = 0; i < op_count; i++) {
+        bench_op_t* op = &ops[i];
+        uint64_t t0 = now_ns();
+        switch (op->op) {
+            case 'a':
+                if (live[op->id]) free(live[op->id]);
+                live[op->id] = malloc(op->size);
+                break;
+            case 'r': {
+                void* ptr = realloc(live[op->id], op->size);
+                if (ptr) live[op->id] = ptr;
+                break;
+            }
+            default:
+                free(live[op->id]);
+                live[op->id] = NULL;
+                break;
+        }
+        uint64_t elapsed = now_ns() - t0;
+        elapsed = elapsed > overhead ? elapsed - overhead : 0;
+        latency[i] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+        total += elapsed;
+        
+        if (i % BENCH_SAMPLE_EVERY == 0) {
+            memory_get_stats(&stats);
+            double frag = fragmentation(&stats);
+            if (frag > peak_frag) peak_frag = frag;
+        }
+    }
+    
+    memory_get_stats(&stats);
+    if (!memory_check_integrity()) {
+        printf("%-18s heap integrity check FAILED\n", name);
+        return;
+    }
+    
+    qsort(latency, op_count, sizeof(latency[0]), compare_u32);
+    printf("%-18s %8d %7.1f %6u %6u %8u %8.1f%% %9zuK %7zuK %7zuK %5u\n",
+           name, op_count, op_count ? (double)total / op_count : 0.0,
+           latency[op_count / 2], latency[op_count * 99 / 100], latency[op_count - 1],
+           peak_frag * 100.0, stats.largest_free / 1024, stats.peak / 1024,
+           stats.total / 1024, stats.failures);
+}
+
+// Run one trace in a child so it gets a fresh heap
+static void bench(const char* name, void (*generate)(int), const char* path) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        op_count = 0;
+        if (generate) {
+            generate(BENCH_MAX_OPS);
+        } else if (!load_trace(path)) {
+            exit(1);
+        }
+        run_trace(name);
+        fflush(stdout);
+        exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char** argv) {
+    printf("%-18s %8s %7s %6s %6s %8s %9s %10s %8s %8s %5s\n",
+           "trace", "ops", "ns/op", "p50", "p99", "max", "peakfrag",
+           "largest", "peak", "heap", "fail");
+    
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            bench(argv[i], NULL, argv[i]);
+        }
+        return 0;
+    }
+    
+    bench("random", gen_random, NULL);
+    bench("producer-consumer", gen_producer_consumer, NULL);
+    bench("realloc-heavy", gen_realloc_heavy, NULL);
+    return 0;
+}
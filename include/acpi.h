@@ -0,0 +1,43 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+// Just enough ACPI to enumerate processors: locate the RSDP, walk the
+// RSDT/XSDT and read the MADT. Tables are identity-mapped as they are used.
+#define ACPI_MAX_CPUS 32
+
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+// What the MADT says about the interrupt controllers
+typedef struct {
+    uint32_t lapic_address;
+    int cpu_count;                      // Enabled or online-capable processors
+    uint8_t apic_ids[ACPI_MAX_CPUS];
+    int ioapic_count;
+    int has_8259;                       // Dual PICs are wired up as well
+} acpi_madt_info_t;
+
+// Find the root table; 0 if there is no ACPI
+int acpi_init(void);
+
+// A table by signature ("APIC", "FACP", ...), checksum verified; NULL if absent
+const acpi_header_t* acpi_find_table(const char* signature);
+
+// Parse the MADT into `info`; 0 if there is none
+int acpi_read_madt(acpi_madt_info_t* info);
+
+// Debug: print the RSDP revision, OEM and table signatures
+void acpi_dump_info(void);
+
+#endif // ACPI_H
@@ -0,0 +1,27 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+// Local APIC, used to identify CPUs and to send inter-processor
+// interrupts. Device IRQs stay on the 8259 PICs, which reach the boot
+// processor through LINT0 in virtual wire mode.
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+
+// Map the register page at `base` (from the MADT) and enable the boot
+// processor's APIC; 0 if the CPU has none
+int lapic_init(uint32_t base);
+int lapic_present(void);
+
+// Software-enable the calling CPU's APIC (application processors)
+void lapic_enable(void);
+
+uint8_t lapic_id(void);
+void lapic_eoi(void);
+
+// Inter-processor interrupts to one CPU by APIC ID
+void lapic_send_init(uint8_t apic_id);
+void lapic_send_startup(uint8_t apic_id, uint32_t trampoline);
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector);
+
+#endif // APIC_H
@@ -0,0 +1,50 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for short-lived scratch memory. Objects are never freed
+// one by one; the whole arena is rolled back to a mark or reset instead.
+#define ARENA_CHUNK_SIZE (32 * 1024)
+#define ARENA_ALIGN 16
+
+// Chunk header; the allocation area follows it
+typedef struct arena_chunk {
+    struct arena_chunk* prev;    // Older chunk
+    size_t size;                 // Bytes available after the header
+    size_t used;
+} __attribute__((aligned(ARENA_ALIGN))) arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t* current;      // Newest chunk, where allocations go
+    arena_chunk_t* spare;        // One released chunk kept for reuse
+    size_t chunk_size;
+    size_t in_use;               // Bytes handed out
+    size_t peak;
+} arena_t;
+
+// Position to roll back to
+typedef struct {
+    arena_chunk_t* chunk;
+    size_t used;
+    size_t in_use;
+} arena_mark_t;
+
+// Arena management
+void arena_init(arena_t* arena, size_t chunk_size);
+void arena_destroy(arena_t* arena);
+void arena_reset(arena_t* arena);
+arena_mark_t arena_mark(arena_t* arena);
+void arena_release(arena_t* arena, arena_mark_t mark);
+
+// Allocation
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_calloc(arena_t* arena, size_t size);
+char* arena_strdup(arena_t* arena, const char* str);
+
+// Scratch arena shared by the shell, or the calling thread's own (see
+// thread_set_scratch()); process_command() releases it after each command,
+// so anything allocated from it lives until the command ends
+arena_t* scratch_arena(void);
+
+#endif // ARENA_H
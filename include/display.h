@@ -1,10 +1,24 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include <stddef.h>
+#include "multiboot.h"
+
 // VGA constants
 #define VIDEO_MEMORY (VideoChar*)0xb8000
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
+#define VGA_TEXT_ROWS (0x8000 / (VGA_WIDTH * 2))    // Rows in the 32KB text window
+#define SCROLLBACK_STEP (display_rows() / 2)       // Lines per Shift+PgUp/PgDn
+
+// Virtual terminals (Alt+F1..F4); in text mode each owns a slice of the
+// text memory
+#define VT_COUNT 4
+#define VT_TEXT_ROWS (VGA_TEXT_ROWS / VT_COUNT)
+
+// Largest text grid the console can hold (1920x1536 with an 8x16 font)
+#define CONSOLE_MAX_COLS 240
+#define CONSOLE_MAX_ROWS 96
 
 // Color definitions
 #define BLACK 0
@@ -35,6 +49,16 @@
 #define COLOR_EXECUTABLE LIGHT_GREEN
 #define COLOR_SPECIAL LIGHT_MAGENTA
 
+// ANSI SGR sequences for the theme colours. The console interprets SGR,
+// cursor movement (CUU/CUD/CUF/CUB/CHA/CUP) and erase (EL/ED) sequences.
+#define ANSI_RESET "\033[0m"
+#define ANSI_ERROR "\033[91m"
+#define ANSI_SUCCESS "\033[92m"
+#define ANSI_WARNING "\033[93m"
+#define ANSI_INFO "\033[96m"
+#define ANSI_PROMPT "\033[96m"
+#define ANSI_DIR "\033[94m"
+
 // Video character structure
 typedef struct {
     char character;
@@ -51,12 +75,23 @@ extern int current_bg_color;
 void enable_cursor(unsigned char cursor_start, unsigned char cursor_end);
 void disable_cursor();
 void update_cursor(int x, int y);
+int display_init_framebuffer(const multiboot_info_t* mbi);
+int display_columns(void);
+int display_rows(void);
+void display_flush(void);
+void display_clear_line(void);
+void display_scroll_view(int lines);
+void display_view_live(void);
+void display_switch_vt(int vt);
+void display_set_output_vt(int vt);
+int display_current_vt(void);
 void clear_screen();
 void set_color(int fg, int bg);
 void shell_print_colored(const char* str, int fg, int bg);
 void scroll_screen();
 void shell_print_char(char c);
 void shell_print_string(const char* str);
+void shell_print_buffer(const char* str, size_t length);
 void print_int(int value);
 void print_hex(unsigned int value);
 
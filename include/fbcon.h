@@ -0,0 +1,33 @@
+#ifndef FBCON_H
+#define FBCON_H
+
+#include <stdint.h>
+#include "display.h"
+#include "multiboot.h"
+
+// Text renderer for a linear 32-bit RGB framebuffer. Cells use the same
+// VideoChar character/attribute pairs as VGA text mode; each (character,
+// attribute) pair is expanded to pixels once and then served from a
+// glyph cache.
+#define GLYPH_CACHE_SIZE 256
+
+// Map the boot loader's framebuffer; 1 if it is usable, 0 to stay in text mode
+int fbcon_init(const multiboot_info_t* mbi);
+
+// Text grid that fits the framebuffer
+int fbcon_columns(void);
+int fbcon_rows(void);
+
+// Draw `count` cells of text row `row` starting at column `col`
+void fbcon_draw(int row, int col, const VideoChar* cells, int count);
+
+// Draw one cell with an underline cursor
+void fbcon_draw_cursor(int row, int col, const VideoChar* cell);
+
+// Fill the whole framebuffer with black
+void fbcon_clear(void);
+
+// Debug: print mode and glyph cache statistics
+void fbcon_dump_info(void);
+
+#endif // FBCON_H
@@ -7,6 +7,7 @@
 #define MAX_CONTENT 512
 #define MAX_DIRS 10
 #define MAX_DIRNAME 32
+#define MAX_PATH_LENGTH 256
 #define TYPE_FILE 1
 #define TYPE_DIR 2
 
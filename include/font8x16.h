@@ -0,0 +1,14 @@
+#ifndef FONT8X16_H
+#define FONT8X16_H
+
+#include <stdint.h>
+
+#define FONT_WIDTH 8
+#define FONT_HEIGHT 16
+#define FONT_FIRST_CHAR 0x20
+#define FONT_LAST_CHAR 0x7E
+#define FONT_GLYPH_COUNT (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+
+extern const uint8_t font8x16[FONT_GLYPH_COUNT][FONT_HEIGHT];
+
+#endif // FONT8X16_H
@@ -13,6 +13,7 @@ typedef struct {
     uint8_t ssse3;
     uint8_t sse4_1;
     uint8_t sse4_2;
+    uint8_t erms;           // Fast rep movsb/stosb
 } CPUFeatures;
 
 // CPU Information structure
@@ -64,6 +65,10 @@ void detect_cpu_info(void);
 void detect_memory_info(void);
 void scan_pci_devices(void);
 void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+int cpu_has_cpuid(void);
+int cpu_has_erms(void);
+int cpu_enable_sse(void);
 uint32_t pci_config_read(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset);
 uint16_t pci_config_read16(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset);
 uint8_t pci_config_read8(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset);
@@ -0,0 +1,85 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdint.h>
+
+// Segment selectors of the kernel's flat GDT. Every CPU has its own copy
+// of the table, whose last entry is that CPU's task state segment.
+#define KERNEL_CODE_SELECTOR 0x08
+#define KERNEL_DATA_SELECTOR 0x10
+#define KERNEL_TSS_SELECTOR 0x18
+#define GDT_ENTRIES 4
+
+// CPU exceptions occupy vectors 0-31
+#define EXCEPTION_COUNT 32
+
+// The two 8259 PICs are remapped so IRQ 0-15 arrive on vectors 32-47
+#define IRQ_BASE 32
+#define IRQ_COUNT 16
+
+// Vectors delivered by the local APIC rather than the PICs
+#define IPI_WAKEUP_VECTOR 0xF0          // Rouses a halted CPU; no other effect
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// Register state pushed by the stubs in isr.asm, lowest address first
+typedef struct {
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error_code;
+    uint32_t eip, cs, eflags;
+} interrupt_frame_t;
+
+typedef void (*irq_handler_t)(interrupt_frame_t* frame);
+
+// 32-bit task state segment. Only the ring 0 stack is used; the kernel
+// never switches tasks through it.
+typedef struct {
+    uint32_t link;
+    uint32_t esp0;
+    uint32_t ss0;
+    uint32_t unused[22];                // esp1 through the LDT selector
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+typedef struct {
+    uint64_t gdt[GDT_ENTRIES];
+    tss_t tss;
+} __attribute__((aligned(16))) cpu_descriptors_t;
+
+// Load the GDT and IDT (exceptions halt with a register dump) and remap
+// the PICs with every IRQ masked
+void interrupts_init(void);
+
+// Give an application processor its own GDT and TSS and load the shared
+// IDT; stack_top becomes the TSS ring 0 stack
+void interrupts_init_cpu(cpu_descriptors_t* descriptors, uint32_t stack_top);
+
+// Install a handler and unmask its line; 0 if the IRQ is invalid or taken
+int irq_register(int irq, irq_handler_t handler);
+void irq_unregister(int irq);
+
+// 1 if the line has been raised but its interrupt not yet delivered
+int irq_pending(int irq);
+
+// Global interrupt flag
+void interrupts_enable(void);
+void interrupts_disable(void);
+int interrupts_enabled(void);
+
+// Disable interrupts and return the previous EFLAGS for irq_restore()
+uint32_t irq_save(void);
+void irq_restore(uint32_t flags);
+
+// Wait for something to happen: once threads run, block the caller until
+// the next interrupt so other threads get the CPU; before that, halt when
+// interrupts are enabled, otherwise execute a pause. Polling loops call
+// this between checks; an interrupt landing just before the block costs
+// at most one timer tick of latency.
+void cpu_idle(void);
+
+// Called from isr.asm for every vector
+void interrupt_dispatch(interrupt_frame_t* frame);
+
+#endif // INTERRUPTS_H
@@ -8,6 +8,16 @@ void outl(unsigned short port, unsigned int data);
 unsigned char inb(unsigned short port);
 unsigned short inw(unsigned short port);
 unsigned int inl(unsigned short port);
+
+// Short pause between accesses to slow devices (PIC, PIT)
+void io_wait(void);
+
+// Model-specific registers
+unsigned long long rdmsr(unsigned int msr);
+void wrmsr(unsigned int msr, unsigned long long value);
+
+// Wait DELAY_MS on the timer (see ksleep_ms)
+#define DELAY_MS 100
 void delay();
 
 #endif // IO_H
\ No newline at end of file
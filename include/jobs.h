@@ -0,0 +1,30 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// Shell job control. A command line ending in '&' runs in its own kernel
+// thread at low priority; what it prints is kept in a per-job buffer and
+// shown when the job is brought to the foreground or has finished, so it
+// never lands in the middle of the prompt. A job that reads the keyboard
+// stops until it is brought to the foreground.
+#define JOB_MAX 8
+#define JOB_OUTPUT_SIZE 8192            // Output kept per job; the rest is dropped
+#define JOB_COMMAND_LENGTH 256
+
+// Start `command` (without the '&') as a job; returns its number, or -1
+int job_start(const char* command);
+
+// `jobs`: list jobs with their state
+void jobs_list(void);
+
+// `fg [n]`: show job n's output so far, let the rest through to the
+// screen and wait for it. The most recent job if n is 0. -1 if no such job.
+int job_foreground(int number);
+
+// `wait [n]`: wait for job n, or every job if n is 0; -1 if no such job.
+// Jobs stopped for input are reported instead of waited for.
+int job_wait(int number);
+
+// Report and forget finished jobs; the shell calls this before the prompt
+void jobs_notify(void);
+
+#endif // JOBS_H
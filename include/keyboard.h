@@ -4,6 +4,9 @@
 // Keyboard ports
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
+#define KEYBOARD_IRQ 1
+#define SCANCODE_RING_SIZE 256      // Power of two
+#define KBD_WAIT_LIMIT 100000       // Status polls before kbd_wait() gives up
 #define KEYBOARD_COMMAND_PORT 0x64
 
 // Key flags
@@ -15,6 +18,8 @@
 #define KEY_NUM 0x20
 #define KEY_SCROLL 0x40
 #define KEY_E0 0x80
+#define KEY_RCTRL 0x100             // Right-hand keys (E0 prefix) have their own
+#define KEY_RALT 0x200              // bits, clear of the lock bits above
 
 // LED flags
 #define LED_SCROLL 0x01
@@ -85,9 +90,10 @@
 #define KEY_HOME_CODE 0x147
 #define KEY_END_CODE 0x14F
 #define KEY_ESC_CODE 0x101
+#define KEY_VT_SWITCH 0x160     // Alt+F1..F4 changed the virtual terminal
 
 // Global variables
-extern unsigned char kbd_flags;
+extern unsigned short kbd_flags;
 extern unsigned char kbd_leds;
 extern unsigned char extended_key;
 extern unsigned char e1_prefix;
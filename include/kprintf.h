@@ -0,0 +1,28 @@
+#ifndef KPRINTF_H
+#define KPRINTF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Freestanding printf family. Supported conversions:
+//   %d %i %u %x %X %c %s %p %%
+// with flags '-' and '0', a width (or '*'), a precision for %s, and the
+// length modifiers l, ll and z. Output is truncated to the buffer size but
+// the return value is the full formatted length, as with snprintf.
+#define KPRINTF_BUFFER_SIZE 512
+
+int kvsnprintf(char* buffer, size_t size, const char* format, va_list args);
+int ksnprintf(char* buffer, size_t size, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Format into a stack buffer and hand it to the display in one call
+int kprintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+int kprintf_colored(int fg, int bg, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Human-readable size with one decimal ("512B", "1.5KB", "3.0MB"),
+// integer arithmetic only. Returns `buffer`.
+char* kformat_size(uint64_t bytes, char* buffer, size_t size);
+
+#endif // KPRINTF_H
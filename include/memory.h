@@ -3,22 +3,74 @@
 
 #include <stddef.h>
 
+// Hosted builds (bench/) rename the allocator so it can sit beside libc
+#ifdef MEMORY_HOSTED
+#define malloc heap_malloc
+#define malloc_aligned heap_malloc_aligned
+#define free heap_free
+#define calloc heap_calloc
+#define realloc heap_realloc
+#endif
+
 // Memory management for oszoOS
 #define MEMORY_POOL_SIZE (1024 * 1024) // 1MB memory pool
 #define MIN_BLOCK_SIZE 16
 #define MAX_BLOCK_SIZE (MEMORY_POOL_SIZE / 4)
 
-// Memory block structure
+// Segregated-fit (TLSF) parameters: sizes are split into power-of-two
+// first-level classes, each subdivided linearly into second-level bins.
+#define MEMORY_ALIGN_LOG2 4
+#define MEMORY_ALIGN (1 << MEMORY_ALIGN_LOG2)        // 16-byte payload alignment
+#define MEMORY_SL_LOG2 4
+#define MEMORY_SL_COUNT (1 << MEMORY_SL_LOG2)        // 16 bins per class
+#define MEMORY_FL_SHIFT (MEMORY_SL_LOG2 + MEMORY_ALIGN_LOG2)
+#define MEMORY_FL_MAX 31                             // blocks stay below 2GB
+#define MEMORY_FL_COUNT (MEMORY_FL_MAX - MEMORY_FL_SHIFT + 1)
+#define MEMORY_SMALL_BLOCK (1 << MEMORY_FL_SHIFT)    // below this, one bin per 16 bytes
+
+// Allocation size histogram: bucket 0 holds requests up to 16 bytes, bucket
+// n those in (2^(n+3), 2^(n+4)], the last one everything larger
+#define MEMORY_HIST_BUCKETS 16
+#define MEMORY_MAX_CALLERS 16
+
+// Heap regions: the static pool plus memory added at run time
+#define MEMORY_MAX_REGIONS 32
+#define MEMORY_REGION_MAX (1UL << 30)                // keeps every block inside the bins
+
+// Memory block header. Blocks are laid out back to back in the pool; the
+// free-list links of a free block live in its (unused) payload.
 typedef struct memory_block {
-    size_t size;
+    size_t size;                      // Payload size in bytes
     int free;
-    struct memory_block* next;
-    struct memory_block* prev;
-} memory_block_t;
+    struct memory_block* prev_phys;   // Physically preceding block (NULL for first)
+    void* caller;                     // Allocation site, when tracking is on
+} __attribute__((aligned(MEMORY_ALIGN))) memory_block_t;
+
+// Heap statistics, maintained incrementally
+typedef struct {
+    size_t total;                     // Bytes in all regions, headers included
+    size_t used;                      // Used blocks, headers included
+    size_t free;                      // Payload bytes of free blocks
+    size_t peak;                      // Highest `used` seen
+    size_t largest_free;              // Payload of the biggest free block
+    unsigned int regions;
+    unsigned int free_blocks;
+    unsigned int allocs;
+    unsigned int frees;
+    unsigned int failures;
+    unsigned int histogram[MEMORY_HIST_BUCKETS];
+} memory_stats_t;
+
+// Called when the heap runs dry; returns a region of at least *bytes and
+// stores its actual size back in *bytes, or NULL if none is left
+typedef void* (*memory_grow_fn)(size_t* bytes);
 
 // Memory management functions
 void memory_init(void);
+int memory_add_region(void* start, size_t size);
+void memory_set_grow_handler(memory_grow_fn handler);
 void* malloc(size_t size);
+void* malloc_aligned(size_t size, size_t align);
 void free(void* ptr);
 void* calloc(size_t num, size_t size);
 void* realloc(void* ptr, size_t new_size);
@@ -27,9 +79,16 @@ void* realloc(void* ptr, size_t new_size);
 size_t memory_get_free(void);
 size_t memory_get_used(void);
 size_t memory_get_total(void);
+void memory_get_stats(memory_stats_t* stats);
+
+// Per-call-site tagging (off by default)
+void memory_set_caller_tracking(int enabled);
+int memory_get_caller_tracking(void);
 
 // Debug functions
 void memory_dump(void);
 int memory_check_integrity(void);
+void memory_dump_stats(void);
+void memory_dump_callers(void);
 
-#endif // MEMORY_H
\ No newline at end of file
+#endif // MEMORY_H
@@ -0,0 +1,82 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+
+// Multiboot (v0.6.96) boot information, as handed over by GRUB in EBX
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+// multiboot_info_t.flags
+#define MULTIBOOT_INFO_MEMORY       0x00000001  // mem_lower/mem_upper valid
+#define MULTIBOOT_INFO_BOOTDEV      0x00000002
+#define MULTIBOOT_INFO_CMDLINE      0x00000004
+#define MULTIBOOT_INFO_MODS         0x00000008
+#define MULTIBOOT_INFO_MEM_MAP      0x00000040  // mmap_length/mmap_addr valid
+#define MULTIBOOT_INFO_LOADER_NAME  0x00000200
+#define MULTIBOOT_INFO_VBE_INFO     0x00000800
+#define MULTIBOOT_INFO_FRAMEBUFFER  0x00001000
+
+// Memory map entry types
+#define MULTIBOOT_MEMORY_AVAILABLE        1
+#define MULTIBOOT_MEMORY_RESERVED         2
+#define MULTIBOOT_MEMORY_ACPI_RECLAIMABLE 3
+#define MULTIBOOT_MEMORY_NVS              4
+#define MULTIBOOT_MEMORY_BADRAM           5
+
+// Framebuffer types
+#define MULTIBOOT_FRAMEBUFFER_TYPE_INDEXED  0
+#define MULTIBOOT_FRAMEBUFFER_TYPE_RGB      1
+#define MULTIBOOT_FRAMEBUFFER_TYPE_EGA_TEXT 2
+
+// Boot information structure
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;              // KB below 1MB
+    uint32_t mem_upper;              // KB above 1MB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+    uint32_t vbe_control_info;
+    uint32_t vbe_mode_info;
+    uint16_t vbe_mode;
+    uint16_t vbe_interface_seg;
+    uint16_t vbe_interface_off;
+    uint16_t vbe_interface_len;
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch;
+    uint32_t framebuffer_width;
+    uint32_t framebuffer_height;
+    uint8_t framebuffer_bpp;
+    uint8_t framebuffer_type;
+    uint8_t color_info[6];
+} __attribute__((packed)) multiboot_info_t;
+
+// Memory map entry; `size` does not count itself
+typedef struct {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+// Boot module; the list is at mods_addr
+typedef struct {
+    uint32_t mod_start;
+    uint32_t mod_end;                // First byte past the module
+    uint32_t string;
+    uint32_t reserved;
+} __attribute__((packed)) multiboot_module_t;
+
+#define MULTIBOOT_VBE_CONTROL_INFO_SIZE 512
+#define MULTIBOOT_VBE_MODE_INFO_SIZE 256
+
+#endif // MULTIBOOT_H
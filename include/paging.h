@@ -0,0 +1,56 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// x86 32-bit paging (4KB tables, 4MB PSE pages)
+#define PAGE_TABLE_ENTRIES 1024
+#define LARGE_PAGE_SIZE (4 * 1024 * 1024)
+
+// Page directory / table entry bits
+#define PAGE_PRESENT       0x001
+#define PAGE_WRITE         0x002
+#define PAGE_USER          0x004
+#define PAGE_WRITE_THROUGH 0x008
+#define PAGE_CACHE_DISABLE 0x010
+#define PAGE_ACCESSED      0x020
+#define PAGE_DIRTY         0x040
+#define PAGE_PAT           0x080    // In a 4KB PTE
+#define PAGE_LARGE         0x080    // In a PDE: maps a 4MB page
+#define PAGE_GLOBAL        0x100
+#define PAGE_LARGE_PAT     0x1000   // In a 4MB PDE
+#define PAGE_FRAME_MASK    0xFFFFF000
+#define PAGE_LARGE_MASK    0xFFC00000
+
+// RAM is identity-mapped up to here; the top 4MB is left for device mappings
+#define IDENTITY_MAP_LIMIT 0xFFC00000ULL
+
+// Memory types for the mapping API
+typedef enum {
+    PAGE_CACHE_WB = 0,              // Normal RAM
+    PAGE_CACHE_WC,                  // Frame buffers (PAT entry 4)
+    PAGE_CACHE_UC                   // Device registers
+} page_cache_t;
+
+// Initialization
+void paging_init(void);
+void paging_init_cpu(void);             // On each application processor
+int paging_enabled(void);
+
+// Driver mapping API. Addresses are rounded out to whole pages; large pages
+// are split on demand. Return 1 on success, 0 if a page table is unavailable.
+int paging_map_page(uint32_t virt, uint32_t phys, uint32_t flags);
+int paging_map_range(uint32_t virt, uint32_t phys, size_t size, page_cache_t cache);
+int paging_map_mmio(uint32_t phys, size_t size);
+int paging_map_wc(uint32_t phys, size_t size);
+void paging_unmap_page(uint32_t virt);
+uint32_t paging_get_physical(uint32_t virt);
+
+// Drain write-combining buffers so device memory sees pending stores
+void paging_flush_wc(void);
+
+// Debug functions
+void paging_dump_info(void);
+
+#endif // PAGING_H
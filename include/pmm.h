@@ -0,0 +1,41 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "multiboot.h"
+
+// Physical page-frame allocator (one bit per 4KB frame)
+#define PAGE_SIZE 4096
+#define PMM_MAX_REGIONS 32
+#define PMM_MAX_BOOT_RANGES 32          // Boot loader data kept out of the allocator
+#define PMM_HEAP_GROW_MIN (1024 * 1024) // Grow the heap at least 1MB at a time
+
+// Usable or reserved range reported by the boot loader
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+} pmm_region_t;
+
+// Initialization
+void pmm_init(multiboot_info_t* mbi);
+
+// Frame allocation
+void* pmm_alloc_frame(void);
+void* pmm_alloc_frames(size_t count);
+void pmm_free_frame(void* frame);
+void pmm_free_frames(void* base, size_t count);
+
+// Heap growth hook for memory_set_grow_handler()
+void* pmm_heap_grow(size_t* bytes);
+
+// Statistics
+size_t pmm_get_total_memory(void);
+size_t pmm_get_free_memory(void);
+uint32_t pmm_get_memory_end(void);
+
+// Debug functions
+void pmm_dump_map(void);
+
+#endif // PMM_H
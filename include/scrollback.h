@@ -0,0 +1,33 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <stddef.h>
+#include "display.h"
+
+// Lines scrolled off the top of the console are kept here. Each line is
+// stored as its text without trailing blanks, followed by its attributes
+// run-length encoded, so a typical single-colour line costs a few bytes
+// more than its text. Each virtual terminal has its own history.
+#define SCROLLBACK_BYTES (64 * 1024)
+#define SCROLLBACK_LINES 2048
+
+typedef struct {
+    unsigned char store[SCROLLBACK_BYTES];
+    unsigned int line_offset[SCROLLBACK_LINES];   // Ring of record offsets
+    int first_line;                               // Oldest entry in line_offset
+    int line_count;
+    unsigned int write_pos;
+} scrollback_t;
+
+// Append one screen row of `columns` cells (at most CONSOLE_MAX_COLS)
+void scrollback_push(scrollback_t* history, const VideoChar* row, int columns);
+
+// Number of lines currently held
+int scrollback_count(const scrollback_t* history);
+
+// Decode line `index` (0 = oldest) into `columns` cells; 0 if out of range
+int scrollback_get(const scrollback_t* history, int index, VideoChar* row, int columns);
+
+void scrollback_clear(scrollback_t* history);
+
+#endif // SCROLLBACK_H
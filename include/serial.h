@@ -0,0 +1,29 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stddef.h>
+
+// COM1, 115200 baud 8N1, driven by IRQ 4. Output is queued in a transmit
+// ring that the interrupt handler drains into the 16-byte FIFO; received
+// bytes are queued by the handler until serial_read_key() takes them.
+#define SERIAL_COM1 0x3F8
+#define SERIAL_IRQ 4
+#define SERIAL_TX_SIZE 4096             // Power of two
+#define SERIAL_RX_SIZE 4096             // Power of two
+
+// Probe and program the UART; 1 if present. Needs interrupts_init() first.
+int serial_init(void);
+int serial_present(void);
+
+// Queue output; '\n' is sent as CR LF and '\b' erases the previous column
+void serial_put_char(char c);
+void serial_write(const char* str, size_t length);
+
+// Next input key, with CR, DEL and VT100 cursor keys translated to the
+// keyboard driver's codes; -1 if nothing is waiting
+int serial_read_key(void);
+
+// Debug: print line state and ring counters
+void serial_dump_info(void);
+
+#endif // SERIAL_H
@@ -30,8 +30,12 @@ void show_hardware_help();
 void show_shutdown_help();
 void show_clear_help();
 void show_memory_help();
+void show_time_help();
+void show_ps_help();
+void show_jobs_help();
 
 void readline(char* buffer, int max_len);
+void shell_print_prompt(const char* path);
 int find_matching_commands(const char* prefix, char matches[][128], int max_matches);
 int find_matching_files(const char* prefix, char matches[][128], int max_matches, int only_files);
 void get_current_path(char* buffer);
@@ -0,0 +1,62 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include "smp.h"
+
+// Slab object caches for fixed-size kernel objects. Each cache has its own
+// lock, so objects may be allocated and freed from any thread or CPU.
+#define SLAB_SIZE 4096              // Minimum slab size (grown to fit SLAB_MIN_OBJECTS)
+#define SLAB_MIN_OBJECTS 8
+#define CACHE_LINE_SIZE 64
+#define KMEM_CACHE_NAME_LEN 24
+
+struct kmem_cache;
+
+// Slab header, stored at the start of each slab-aligned chunk
+typedef struct slab {
+    struct kmem_cache* cache;
+    struct slab* next;
+    struct slab* prev;
+    void* free_objects;          // Linked through the first word of each free object
+    unsigned int in_use;
+} slab_t;
+
+// Object cache
+typedef struct kmem_cache {
+    char name[KMEM_CACHE_NAME_LEN];
+    size_t object_size;          // Requested object size
+    size_t stride;               // Object size rounded up to the alignment
+    size_t align;
+    size_t slab_size;            // Power of two; slabs are aligned to it
+    size_t first_offset;         // Offset of the first object within a slab
+    unsigned int objects_per_slab;
+    void (*ctor)(void* obj);     // Optional, run on every allocation
+    spinlock_t lock;             // Guards the slab lists and statistics
+    
+    slab_t* partial;             // Slabs with both free and used objects
+    slab_t* full;
+    slab_t* empty;
+    
+    // Statistics
+    unsigned int slab_count;
+    unsigned int active_objects;
+    unsigned int alloc_count;
+    unsigned int free_count;
+    
+    struct kmem_cache* next;     // Global cache list
+} kmem_cache_t;
+
+// Cache management
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void* obj));
+void kmem_cache_destroy(kmem_cache_t* cache);
+void kmem_cache_shrink(kmem_cache_t* cache);
+
+// Object allocation
+void* kmem_cache_alloc(kmem_cache_t* cache);
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+// Debug functions
+void kmem_cache_dump_stats(void);
+
+#endif // SLAB_H
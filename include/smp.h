@@ -0,0 +1,59 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "interrupts.h"
+
+// Symmetric multiprocessing. The application processors listed in the
+// ACPI MADT are started with INIT-SIPI-SIPI, each on its own stack with its
+// own GDT and TSS, and then wait halted in an idle loop for work.
+#define SMP_MAX_CPUS 16
+#define AP_STACK_SIZE 16384
+
+typedef void (*smp_work_t)(void* arg);
+
+typedef struct {
+    uint32_t index;                     // 0 is the boot processor
+    uint8_t apic_id;
+    volatile int online;
+    uint8_t* stack;                     // AP_STACK_SIZE bytes; NULL on the BSP
+    cpu_descriptors_t descriptors;
+    
+    // Mailbox: one function at a time, run by the idle loop
+    volatile int mailbox_busy;
+    smp_work_t volatile work;
+    void* volatile work_arg;
+    volatile uint32_t work_done;        // Functions run so far
+} cpu_t;
+
+// Find and start the other processors; returns the number of CPUs online.
+// Needs paging, the heap, the timer and interrupts enabled.
+int smp_init(void);
+
+int smp_cpu_count(void);
+cpu_t* smp_cpu(int index);
+
+// Index of the calling CPU in the table, from its APIC ID
+int smp_cpu_index(void);
+
+// Run work(arg) on an application processor; waits while its mailbox is
+// still taken. 0 if the index is not an AP. The function runs with
+// interrupts on and must not use the console, which is not SMP-safe.
+int smp_call(int index, smp_work_t work, void* arg);
+
+// Wait until the CPU's mailbox is free again
+void smp_wait(int index);
+
+// Lock for data shared between processors. It is taken with interrupts
+// off, so an interrupt on the holding CPU cannot spin on it; hold it briefly.
+typedef struct {
+    volatile int locked;
+} spinlock_t;
+
+uint32_t spin_lock_irqsave(spinlock_t* lock);
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags);
+
+// Debug: print the processors and the APIC layout
+void smp_dump_info(void);
+
+#endif // SMP_H
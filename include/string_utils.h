@@ -28,7 +28,17 @@ size_t my_strcspn(const char* s, const char* reject);
 char* strtok_r(char* str, const char* delim, char** saveptr);
 char* itoa(int value, char* str);
 char* itoa_hex(uint32_t value, char* str);
+
+// Memory and string primitives. Each call goes through the variant chosen
+// by string_select_variants(); until then the plain i386 versions are used.
+void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
 void* memset(void* s, int c, size_t n);
+int memcmp(const void* a, const void* b, size_t n);
+void* memchr(const void* s, int c, size_t n);
+void* memsetw(void* s, uint16_t value, size_t count);
+void string_select_variants(int use_sse2, int use_erms);
+const char* string_variant_name(void);
 
 // Safe string functions
 char* safe_strcpy(char* dest, const char* src, size_t dest_size);
@@ -0,0 +1,40 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+
+// Fork-join tasks run by every online CPU. Each CPU is a worker with a
+// Chase-Lev deque: it pushes and pops its own tasks at the bottom, and an
+// idle worker steals the oldest task from the top of another's deque.
+//
+// On the boot processor one thread at a time owns worker 0; its first
+// task_spawn() calls the application processors into the pool and its
+// last task_wait() lets them go. Tasks spawned by any other thread, or
+// with no APs online, run at once in the caller. Tasks may use the heap
+// but not the console, which is not SMP-safe.
+#define TASK_DEQUE_SIZE 256             // Power of two; a full deque runs tasks inline
+
+typedef void (*task_fn)(void* arg);
+
+// Owned by the caller, which must keep it alive until task_wait() returns
+typedef struct {
+    task_fn fn;
+    void* arg;
+    volatile int done;
+} task_t;
+
+// Queue fn(arg) to run on any worker. Every spawned task must be waited on.
+void task_spawn(task_t* task, task_fn fn, void* arg);
+
+// Run other tasks until this one has finished
+void task_wait(task_t* task);
+
+// Split [begin, end) into chunks of at most `grain` indices (0 picks a size
+// from the CPU count) and call fn(arg, first, last) on each in parallel
+typedef void (*task_range_fn)(void* arg, uint32_t begin, uint32_t end);
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, task_range_fn fn, void* arg);
+
+// Debug: print tasks run and stolen per worker
+void task_dump_info(void);
+
+#endif // TASK_H
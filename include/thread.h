@@ -0,0 +1,116 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "timer.h"
+#include "arena.h"
+
+// Kernel threads on the boot processor with preemptive round-robin
+// scheduling. The highest priority level with a ready thread runs; threads
+// of one level share the CPU in time slices. The context is the callee-
+// saved registers pushed on the thread's own stack by thread_switch();
+// a preempted thread's full state is the interrupt frame below that.
+#define THREAD_STACK_SIZE 16384
+#define THREAD_NAME_LENGTH 16
+#define THREAD_TIME_SLICE 5             // Ticks before a thread is rotated out
+#define THREAD_FPU_STATE_SIZE 512       // fxsave area
+
+#define THREAD_PRIORITY_HIGH 0
+#define THREAD_PRIORITY_NORMAL 1
+#define THREAD_PRIORITY_LOW 2
+#define THREAD_PRIORITY_COUNT 3
+
+typedef enum {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,
+    THREAD_DEAD
+} thread_state_t;
+
+typedef void (*thread_fn)(void* arg);
+
+// Where a thread's console output goes instead of the screen; returns 0 to
+// let it through after all
+typedef int (*thread_output_fn)(void* data, const char* text, size_t length);
+
+typedef struct thread {
+    uint32_t esp;                       // Saved by thread_switch()
+    uint32_t id;
+    char name[THREAD_NAME_LENGTH];
+    int priority;
+    thread_state_t state;
+    uint32_t slice;                     // Ticks left in the current slice
+    uint64_t ticks;                     // Timer ticks spent running
+    uint8_t* stack;                     // NULL for the boot thread
+    thread_fn entry;
+    void* arg;
+    timer_event_t wakeup;               // For thread_sleep_ms()
+    struct thread* next;                // Run queue or wait queue
+    struct thread* next_all;
+    thread_output_fn output;            // NULL: the console
+    void* output_data;
+    int output_fg;                      // Colours of redirected output, which
+    int output_bg;                      // travel in it as SGR sequences
+    arena_t* scratch;                   // NULL: the shell's scratch arena
+    volatile int input_blocked;         // In thread_wait_console()
+    
+    // x87/SSE registers, switched only once SSE is enabled: the SSE2
+    // string routines keep data in xmm registers across a preemption
+    uint8_t fpu_state[THREAD_FPU_STATE_SIZE] __attribute__((aligned(16)));
+} thread_t;
+
+// Threads waiting for an event, woken all at once
+typedef struct {
+    thread_t* head;
+} wait_queue_t;
+
+// Turn the running boot code into the first thread and start scheduling.
+// Needs the heap and the timer.
+void thread_init(const char* name);
+int thread_scheduler_running(void);
+
+// Start entry(arg) in a new thread; 0 if out of memory. A thread ends
+// by returning from entry or calling thread_exit().
+uint32_t thread_create(const char* name, thread_fn entry, void* arg, int priority);
+void thread_exit(void) __attribute__((noreturn));
+
+thread_t* thread_current(void);
+void thread_yield(void);
+void thread_sleep_ms(uint32_t ms);
+
+// Block until the thread with this ID has exited (at once if there is none)
+void thread_join(uint32_t id);
+int thread_exists(uint32_t id);
+
+// Redirect the calling thread's console output and scratch allocations
+void thread_set_output(thread_output_fn output, void* data);
+void thread_set_scratch(arena_t* arena);
+
+// The keyboard belongs to threads whose output reaches the screen. A
+// redirected thread (a background job) blocks here until its sink lets
+// output through; whoever changes that calls thread_console_changed().
+void thread_wait_console(void);
+void thread_console_changed(void);
+
+// Wait queues; call with interrupts off
+void thread_block(wait_queue_t* queue);
+void thread_wake_all(wait_queue_t* queue);
+
+// Block the calling thread until the next interrupt; 0 if it cannot
+// (no scheduler, the idle thread, preemption off, or not the boot CPU)
+int thread_wait_interrupt(void);
+
+// Keep the scheduler from switching away while shared state (the console)
+// is being updated. Nests; a switch requested meanwhile happens at the end.
+void preempt_disable(void);
+void preempt_enable(void);
+
+// Called from the timer interrupt and at the end of every IRQ
+void thread_tick(void);
+void thread_irq_exit(void);
+
+// List the threads for `ps`
+void thread_dump_info(void);
+
+#endif // THREAD_H
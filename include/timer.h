@@ -0,0 +1,57 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// PIT channel 0 drives IRQ 0 at a programmable rate; every interrupt
+// advances the tick counter and runs the timer wheel
+#define TIMER_IRQ 0
+#define PIT_BASE_FREQUENCY 1193182
+#define TIMER_DEFAULT_HZ 100
+#define TIMER_WHEEL_SLOTS 256           // Power of two
+
+typedef void (*timer_callback_t)(void* data);
+
+// A deferred callback, owned by the caller and linked into the wheel while
+// pending. Callbacks run from the timer interrupt with interrupts off, so
+// they must be short and must not sleep.
+typedef struct timer_event {
+    struct timer_event* next;
+    struct timer_event* prev;
+    uint64_t expires;                   // Tick at which it fires
+    uint32_t period;                    // Ticks between firings, 0 for one-shot
+    timer_callback_t callback;
+    void* data;
+    int pending;
+} timer_event_t;
+
+// Program the PIT and install the IRQ 0 handler; 0 if the IRQ is taken.
+// Needs interrupts_init() first.
+int timer_init(uint32_t hz);
+
+// Change the tick rate (clamped to what the 16-bit divisor can express)
+void timer_set_frequency(uint32_t hz);
+uint32_t timer_frequency(void);
+
+// Ticks since timer_init(), and the same converted to seconds / ms
+uint64_t timer_ticks(void);
+uint32_t timer_uptime_seconds(void);
+uint64_t timer_uptime_ms(void);
+
+// Wait at least the given time, measured on the PIT counter. Whole ticks
+// are slept with hlt when interrupts are on; the rest is a short spin.
+void ksleep_ms(uint32_t ms);
+void ksleep_us(uint32_t us);
+
+// Schedule event->callback after delay_ms, then every period_ms if that is
+// nonzero. Rearming a pending event moves it. Both are rounded up to ticks.
+void timer_event_init(timer_event_t* event, timer_callback_t callback, void* data);
+void timer_start(timer_event_t* event, uint32_t delay_ms, uint32_t period_ms);
+
+// Remove a pending event; 1 if it was pending
+int timer_cancel(timer_event_t* event);
+
+// Debug: print the rate, tick count and pending events
+void timer_dump_info(void);
+
+#endif // TIMER_H
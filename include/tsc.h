@@ -0,0 +1,26 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+
+// Time stamp counter clocksource. tsc_init() times PIT channel 2 one-shots
+// with RDTSC to find the TSC rate; ktime_ns() then scales the counter with
+// a fixed-point multiply. Without a TSC it falls back to the PIT tick.
+#define TSC_CALIBRATE_MS 20             // Length of one calibration window
+#define TSC_CALIBRATE_RUNS 3            // Windows measured; the median is used
+
+// Calibrate; 1 if a usable TSC was found. Needs timer_init() for the fallback.
+int tsc_init(void);
+int tsc_present(void);
+uint64_t tsc_frequency(void);           // Hz, 0 if not calibrated
+
+uint64_t rdtsc(void);
+
+// Nanoseconds since tsc_init(), and a raw cycle delta in nanoseconds
+uint64_t ktime_ns(void);
+uint64_t tsc_cycles_to_ns(uint64_t cycles);
+
+// Debug: print the calibrated rate
+void tsc_dump_info(void);
+
+#endif // TSC_H
@@ -0,0 +1,182 @@
+#include "acpi.h"
+#include "paging.h"
+#include "pmm.h"
+#include "kprintf.h"
+#include <stddef.h>
+
+#define EBDA_SEGMENT_POINTER 0x40E      // BIOS data area word holding the EBDA segment
+#define BIOS_ROM_START 0xE0000
+#define BIOS_ROM_END 0x100000
+
+// MADT entry types
+#define MADT_LOCAL_APIC 0
+#define MADT_IO_APIC 1
+#define MADT_LAPIC_OVERRIDE 5
+#define MADT_PCAT_COMPAT 0x01           // MADT flags: 8259s present
+#define MADT_CPU_ENABLED 0x01
+#define MADT_CPU_ONLINE_CAPABLE 0x02
+
+typedef struct {
+    char signature[8];                  // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;                   // 0 for ACPI 1.0, 2 and up have an XSDT
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+typedef struct {
+    acpi_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+static const acpi_rsdp_t* rsdp = 0;
+static const acpi_header_t* root = 0;  // RSDT or XSDT
+static int root_entry_size = 4;
+
+static uint8_t checksum(const void* data, uint32_t length) {
+    const uint8_t* bytes = data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += bytes[i];
+    return sum;
+}
+
+// Tables normally sit in RAM, which is identity-mapped already; firmware
+// may also put them in reserved ranges above it
+static int map_range(uint32_t address, uint32_t length) {
+    if (!paging_enabled()) return 1;
+    
+    uint32_t end = address + length;
+    for (uint32_t page = address & PAGE_FRAME_MASK; page < end; page += PAGE_SIZE) {
+        if (paging_get_physical(page) == page) continue;
+        if (!paging_map_range(page, page, PAGE_SIZE, PAGE_CACHE_WB)) return 0;
+        if (page + PAGE_SIZE < page) break;
+    }
+    return 1;
+}
+
+static const acpi_header_t* map_table(uint32_t address) {
+    if (!address || !map_range(address, sizeof(acpi_header_t))) return NULL;
+    const acpi_header_t* header = (const acpi_header_t*)address;
+    if (header->length < sizeof(acpi_header_t) || !map_range(address, header->length)) return NULL;
+    if (checksum(header, header->length) != 0) return NULL;
+    return header;
+}
+
+static const acpi_rsdp_t* scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t address = start; address + sizeof(acpi_rsdp_t) <= end; address += 16) {
+        const acpi_rsdp_t* candidate = (const acpi_rsdp_t*)address;
+        const char* signature = candidate->signature;
+        if (signature[0] != 'R' || signature[1] != 'S' || signature[2] != 'D' || signature[3] != ' ' ||
+            signature[4] != 'P' || signature[5] != 'T' || signature[6] != 'R' || signature[7] != ' ') {
+            continue;
+        }
+        if (checksum(candidate, 20) == 0) return candidate;
+    }
+    return NULL;
+}
+
+int acpi_init(void) {
+    if (root) return 1;
+    
+    // The first KB of the EBDA, then the BIOS area below 1MB
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)EBDA_SEGMENT_POINTER) << 4;
+    if (ebda >= 0x80000 && ebda < 0xA0000) rsdp = scan_rsdp(ebda, ebda + 1024);
+    if (!rsdp) rsdp = scan_rsdp(BIOS_ROM_START, BIOS_ROM_END);
+    if (!rsdp) return 0;
+    
+    // Prefer the XSDT when it is reachable from 32-bit code
+    if (rsdp->revision >= 2 && rsdp->xsdt_address && rsdp->xsdt_address < 0x100000000ULL &&
+        checksum(rsdp, rsdp->length) == 0) {
+        root = map_table((uint32_t)rsdp->xsdt_address);
+        root_entry_size = 8;
+    }
+    if (!root) {
+        root = map_table(rsdp->rsdt_address);
+        root_entry_size = 4;
+    }
+    return root != NULL;
+}
+
+static uint32_t root_entry_count(void) {
+    return (root->length - sizeof(acpi_header_t)) / root_entry_size;
+}
+
+static uint32_t root_entry(uint32_t index) {
+    const uint8_t* entries = (const uint8_t*)root + sizeof(acpi_header_t);
+    if (root_entry_size == 8) {
+        uint64_t address = *(const uint64_t*)(entries + index * 8);
+        return address < 0x100000000ULL ? (uint32_t)address : 0;
+    }
+    return *(const uint32_t*)(entries + index * 4);
+}
+
+const acpi_header_t* acpi_find_table(const char* signature) {
+    if (!root) return NULL;
+    
+    for (uint32_t i = 0; i < root_entry_count(); i++) {
+        uint32_t address = root_entry(i);
+        if (!address || !map_range(address, sizeof(acpi_header_t))) continue;
+        const acpi_header_t* header = (const acpi_header_t*)address;
+        if (header->signature[0] == signature[0] && header->signature[1] == signature[1] &&
+            header->signature[2] == signature[2] && header->signature[3] == signature[3]) {
+            return map_table(address);
+        }
+    }
+    return NULL;
+}
+
+int acpi_read_madt(acpi_madt_info_t* info) {
+    const acpi_madt_t* madt = (const acpi_madt_t*)acpi_find_table("APIC");
+    if (!madt) return 0;
+    
+    info->lapic_address = madt->lapic_address;
+    info->cpu_count = 0;
+    info->ioapic_count = 0;
+    info->has_8259 = (madt->flags & MADT_PCAT_COMPAT) != 0;
+    
+    const uint8_t* entry = (const uint8_t*)madt + sizeof(acpi_madt_t);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    while (entry + 2 <= end && entry[1] >= 2 && entry + entry[1] <= end) {
+        switch (entry[0]) {
+            case MADT_LOCAL_APIC: {
+                // Processor UID, APIC ID, then the flags
+                uint32_t flags = *(const uint32_t*)(entry + 4);
+                if ((flags & (MADT_CPU_ENABLED | MADT_CPU_ONLINE_CAPABLE)) &&
+                    info->cpu_count < ACPI_MAX_CPUS) {
+                    info->apic_ids[info->cpu_count++] = entry[3];
+                }
+                break;
+            }
+            case MADT_IO_APIC:
+                info->ioapic_count++;
+                break;
+            case MADT_LAPIC_OVERRIDE: {
+                uint64_t address = *(const uint64_t*)(entry + 4);
+                if (address < 0x100000000ULL) info->lapic_address = (uint32_t)address;
+                break;
+            }
+        }
+        entry += entry[1];
+    }
+    return 1;
+}
+
+void acpi_dump_info(void) {
+    if (!root) {
+        kprintf("ACPI: no RSDP found\n");
+        return;
+    }
+    kprintf("ACPI: revision %u, OEM %.6s, %s with %u tables:",
+            rsdp->revision, rsdp->oem_id, root_entry_size == 8 ? "XSDT" : "RSDT", root_entry_count());
+    for (uint32_t i = 0; i < root_entry_count(); i++) {
+        uint32_t address = root_entry(i);
+        if (!address || !map_range(address, sizeof(acpi_header_t))) continue;
+        kprintf(" %.4s", ((const acpi_header_t*)address)->signature);
+    }
+    kprintf("\n");
+}
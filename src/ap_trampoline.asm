@@ -0,0 +1,78 @@
+; شيفرة إقلاع المعالجات الثانوية: تُنسخ إلى عنوان منخفض وتبدأ في الوضع الحقيقي
+; بعد إشارة SIPI، ثم تنتقل إلى الوضع المحمي مع التصفيح وتستدعي ap_main
+[bits 16]
+
+section .text
+
+; Must match AP_TRAMPOLINE_ADDRESS in smp.c. The code runs from the copy
+; there, so every absolute address is taken relative to that base.
+%define TRAMPOLINE_BASE 0x8000
+%define ADDR(label) (TRAMPOLINE_BASE + (label) - ap_trampoline_start)
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_params
+
+; The startup IPI begins here with CS:IP = 0800:0000
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    o32 lgdt [ADDR(trampoline_gdt_pointer)]
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+    jmp dword 0x08:ADDR(protected_mode)
+
+[bits 32]
+protected_mode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Same page tables, paging features and FPU/SSE setup as the boot
+    ; processor. The trampoline is identity-mapped, so turning paging on
+    ; does not move the next instruction.
+    mov eax, [ADDR(param_cr4)]
+    mov cr4, eax
+    mov eax, [ADDR(param_cr3)]
+    mov cr3, eax
+    mov eax, [ADDR(param_cr0)]
+    mov cr0, eax
+
+    ; ap_main(cpu) on the processor's own stack, aligned as in kernel_entry
+    mov esp, [ADDR(param_stack)]
+    sub esp, 12
+    push dword [ADDR(param_cpu)]
+    call [ADDR(param_entry)]
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+trampoline_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF       ; 0x08: ring 0 code
+    dq 0x00CF92000000FFFF       ; 0x10: ring 0 data
+trampoline_gdt_pointer:
+    dw trampoline_gdt_pointer - trampoline_gdt - 1
+    dd ADDR(trampoline_gdt)
+
+; Filled in by smp.c before each startup; the layout matches ap_params_t
+align 4
+ap_trampoline_params:
+param_cr0:   dd 0
+param_cr3:   dd 0
+param_cr4:   dd 0
+param_stack: dd 0
+param_entry: dd 0
+param_cpu:   dd 0
+ap_trampoline_end:
+
+; إضافة .note.GNU-stack section لحل التحذير
+section .note.GNU-stack noalloc noexec nowrite progbits
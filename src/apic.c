@@ -0,0 +1,96 @@
+#include "apic.h"
+#include "interrupts.h"
+#include "paging.h"
+#include "io.h"
+#include "hardware_detection.h"
+
+// Register offsets
+#define LAPIC_ID 0x020
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+
+#define MSR_APIC_BASE 0x1B
+#define APIC_BASE_ENABLE 0x800
+#define SVR_ENABLE 0x100
+
+// ICR low word
+#define ICR_FIXED 0x000
+#define ICR_INIT 0x500
+#define ICR_STARTUP 0x600
+#define ICR_ASSERT 0x4000
+#define ICR_SEND_PENDING 0x1000
+
+static volatile uint32_t* lapic = 0;
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+int lapic_init(uint32_t base) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    if (!cpu_has_cpuid()) return 0;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1 << 9))) return 0;
+    
+    if (!base) base = LAPIC_DEFAULT_BASE;
+    if (!paging_map_mmio(base, 4096)) return 0;
+    
+    // Keep the APIC at the address the firmware reported, globally enabled
+    uint64_t msr = rdmsr(MSR_APIC_BASE);
+    msr = (msr & 0xFFF) | (base & 0xFFFFF000) | APIC_BASE_ENABLE;
+    wrmsr(MSR_APIC_BASE, msr);
+    
+    lapic = (volatile uint32_t*)base;
+    lapic_enable();
+    return 1;
+}
+
+int lapic_present(void) {
+    return lapic != 0;
+}
+
+void lapic_enable(void) {
+    lapic_write(LAPIC_SVR, SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+uint8_t lapic_id(void) {
+    if (!lapic) return 0;
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// Write the ICR and wait until the APIC has accepted the message. An
+// interrupt handler sending its own IPI between the two writes would
+// change the destination, hence interrupts off.
+static void send(uint8_t apic_id, uint32_t command) {
+    uint32_t flags = irq_save();
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_SEND_PENDING) {
+        __asm__ volatile ("pause");
+    }
+    irq_restore(flags);
+}
+
+void lapic_send_init(uint8_t apic_id) {
+    send(apic_id, ICR_INIT | ICR_ASSERT);
+}
+
+// The startup vector is the page number of the real-mode entry point
+void lapic_send_startup(uint8_t apic_id, uint32_t trampoline) {
+    send(apic_id, ICR_STARTUP | ICR_ASSERT | ((trampoline >> 12) & 0xFF));
+}
+
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector) {
+    send(apic_id, ICR_FIXED | ICR_ASSERT | vector);
+}
@@ -0,0 +1,149 @@
+#include "arena.h"
+#include "memory.h"
+#include "string_utils.h"
+#include "thread.h"
+
+static arena_t shell_scratch;
+static int shell_scratch_ready = 0;
+
+static size_t align_up(size_t value) {
+    return (value + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static inline unsigned char* chunk_data(arena_chunk_t* chunk) {
+    return (unsigned char*)(chunk + 1);
+}
+
+// Drop the newest chunk, keeping one default-sized chunk around for reuse
+static void pop_chunk(arena_t* arena) {
+    arena_chunk_t* chunk = arena->current;
+    arena->current = chunk->prev;
+    
+    if (!arena->spare && chunk->size == arena->chunk_size) {
+        arena->spare = chunk;
+    } else {
+        free(chunk);
+    }
+}
+
+// Start a chunk able to hold at least `size` bytes
+static arena_chunk_t* push_chunk(arena_t* arena, size_t size) {
+    arena_chunk_t* chunk;
+    
+    if (size <= arena->chunk_size && arena->spare) {
+        chunk = arena->spare;
+        arena->spare = NULL;
+    } else {
+        size_t chunk_size = size > arena->chunk_size ? align_up(size) : arena->chunk_size;
+        chunk = (arena_chunk_t*)malloc(sizeof(arena_chunk_t) + chunk_size);
+        if (!chunk) return NULL;
+        chunk->size = chunk_size;
+    }
+    
+    chunk->used = 0;
+    chunk->prev = arena->current;
+    arena->current = chunk;
+    return chunk;
+}
+
+// Initialize an empty arena; chunks are allocated on first use
+void arena_init(arena_t* arena, size_t chunk_size) {
+    arena->current = NULL;
+    arena->spare = NULL;
+    arena->chunk_size = align_up(chunk_size ? chunk_size : ARENA_CHUNK_SIZE);
+    arena->in_use = 0;
+    arena->peak = 0;
+}
+
+// Return every chunk to the heap
+void arena_destroy(arena_t* arena) {
+    while (arena->current) {
+        arena_chunk_t* chunk = arena->current;
+        arena->current = chunk->prev;
+        free(chunk);
+    }
+    if (arena->spare) {
+        free(arena->spare);
+        arena->spare = NULL;
+    }
+    arena->in_use = 0;
+}
+
+// Release everything allocated from the arena
+void arena_reset(arena_t* arena) {
+    arena_mark_t empty = {NULL, 0, 0};
+    arena_release(arena, empty);
+}
+
+// Remember the current position
+arena_mark_t arena_mark(arena_t* arena) {
+    arena_mark_t mark;
+    mark.chunk = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    mark.in_use = arena->in_use;
+    return mark;
+}
+
+// Free everything allocated since `mark`. Marks nest: releasing an inner
+// mark leaves allocations made before it intact.
+void arena_release(arena_t* arena, arena_mark_t mark) {
+    while (arena->current && arena->current != mark.chunk) {
+        pop_chunk(arena);
+    }
+    if (arena->current) {
+        arena->current->used = mark.used;
+    }
+    arena->in_use = mark.in_use;
+}
+
+// Allocate `size` bytes, aligned to ARENA_ALIGN
+void* arena_alloc(arena_t* arena, size_t size) {
+    if (size == 0) return NULL;
+    size = align_up(size);
+    
+    arena_chunk_t* chunk = arena->current;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = push_chunk(arena, size);
+        if (!chunk) return NULL;
+    }
+    
+    void* ptr = chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    
+    arena->in_use += size;
+    if (arena->in_use > arena->peak) arena->peak = arena->in_use;
+    
+    return ptr;
+}
+
+// Allocate zeroed memory
+void* arena_calloc(arena_t* arena, size_t size) {
+    void* ptr = arena_alloc(arena, size);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+// Copy a string into the arena
+char* arena_strdup(arena_t* arena, const char* str) {
+    size_t len = my_strlen(str) + 1;
+    char* copy = (char*)arena_alloc(arena, len);
+    if (copy) {
+        SAFE_STRCPY(copy, str, len);
+    }
+    return copy;
+}
+
+// Scratch arena of the calling thread: its own if it set one, otherwise
+// the one shared by the shell
+arena_t* scratch_arena(void) {
+    thread_t* self = thread_current();
+    if (self && self->scratch) return self->scratch;
+    
+    if (!shell_scratch_ready) {
+        arena_init(&shell_scratch, ARENA_CHUNK_SIZE);
+        shell_scratch_ready = 1;
+    }
+    return &shell_scratch;
+}
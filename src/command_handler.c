@@ -6,6 +6,20 @@
 #include "string_utils.h"
 #include "fat32.h"
 #include "memory.h"
+#include "arena.h"
+#include "pmm.h"
+#include "paging.h"
+#include "fbcon.h"
+#include "serial.h"
+#include "timer.h"
+#include "tsc.h"
+#include "acpi.h"
+#include "smp.h"
+#include "thread.h"
+#include "task.h"
+#include "jobs.h"
+#include "kprintf.h"
+#include "slab.h"
 #include "fastfetch.h"
 #include "hardware_detection.h"
 
@@ -84,7 +98,7 @@ static void cmd_ls(char* args) {
     if (count == 0) {
         shell_print_string("Directory is empty\n");
     } else {
-        int cols = VGA_WIDTH / (maxlen+3);
+        int cols = display_columns() / (maxlen+3);
         if (cols < 1) cols = 1;
         for (int row = 0; row < (count+cols-1)/cols; row++) {
             for (int col = 0; col < cols; col++) {
@@ -126,15 +140,18 @@ static void cmd_cd(char* args) {
     } else {
         current_dir = new_dir;
         shell_print_colored("Changed to: ", COLOR_SUCCESS, BLACK);
-        char path[256];
-        get_current_path(path);
-        shell_print_colored(path, COLOR_DIR, BLACK);
+        char* path = (char*)arena_alloc(scratch_arena(), MAX_PATH_LENGTH);
+        if (path) {
+            get_current_path(path);
+            shell_print_colored(path, COLOR_DIR, BLACK);
+        }
         shell_print_char('\n');
     }
 }
 
 static void cmd_pwd(char* args __attribute__((unused))) {
-    char path[256];
+    char* path = (char*)arena_alloc(scratch_arena(), MAX_PATH_LENGTH);
+    if (!path) return;
     get_current_path(path);
     shell_print_string(path);
     shell_print_string("\n");
@@ -404,28 +421,26 @@ static void cmd_memory(char* args) {
     if (!args) {
         shell_print_colored("Memory Information:\n", COLOR_INFO, BLACK);
         
-        char buffer[32];
+        size_t total = memory_get_total();
+        size_t used = memory_get_used();
         
         shell_print_colored("Total: ", LIGHT_GREEN, BLACK);
-        itoa(memory_get_total() / 1024, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" KB\n");
+        kprintf("%u KB\n", (unsigned int)(total / 1024));
         
         shell_print_colored("Used: ", LIGHT_GREEN, BLACK);
-        itoa(memory_get_used() / 1024, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" KB\n");
+        kprintf("%u KB\n", (unsigned int)(used / 1024));
         
         shell_print_colored("Free: ", LIGHT_GREEN, BLACK);
-        itoa(memory_get_free() / 1024, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" KB\n");
+        kprintf("%u KB\n", (unsigned int)(memory_get_free() / 1024));
         
         shell_print_colored("Usage: ", LIGHT_GREEN, BLACK);
-        int usage = (memory_get_used() * 100) / memory_get_total();
-        itoa(usage, buffer);
-        shell_print_string(buffer);
-        shell_print_string("%\n");
+        kprintf("%u%%\n", (unsigned int)((used / 1024) * 100 / (total / 1024)));
+        
+        if (pmm_get_total_memory() > 0) {
+            shell_print_colored("Physical: ", LIGHT_GREEN, BLACK);
+            kprintf("%u KB free of %u KB\n", (unsigned int)(pmm_get_free_memory() / 1024),
+                    (unsigned int)(pmm_get_total_memory() / 1024));
+        }
         
         return;
     }
@@ -465,8 +480,53 @@ static void cmd_memory(char* args) {
         } else {
             shell_print_colored("Memory allocation failed\n", COLOR_ERROR, BLACK);
         }
+        
+        kmem_cache_t* cache = kmem_cache_create("test_file_entry", sizeof(FileEntry), 0, NULL);
+        void* objs[16];
+        int allocated = 0;
+        if (cache) {
+            for (allocated = 0; allocated < 16; allocated++) {
+                objs[allocated] = kmem_cache_alloc(cache);
+                if (!objs[allocated]) break;
+            }
+            for (int i = 0; i < allocated; i++) {
+                kmem_cache_free(cache, objs[i]);
+            }
+            kmem_cache_destroy(cache);
+        }
+        if (allocated == 16) {
+            shell_print_colored("Slab cache test successful\n", COLOR_SUCCESS, BLACK);
+        } else {
+            shell_print_colored("Slab cache test failed\n", COLOR_ERROR, BLACK);
+        }
+    } else if (my_strncmp(subcommand, "slabs", 5) == 0) {
+        kmem_cache_dump_stats();
+    } else if (my_strncmp(subcommand, "stats", 5) == 0) {
+        char* option = strtok_r(NULL, " ", &saveptr);
+        if (option && my_strncmp(option, "callers", 7) == 0) {
+            if (memory_get_caller_tracking()) {
+                memory_dump_callers();
+            } else {
+                memory_set_caller_tracking(1);
+                shell_print_colored("Call-site tracking enabled; new allocations will be tagged\n", COLOR_INFO, BLACK);
+            }
+        } else if (option && my_strncmp(option, "off", 3) == 0) {
+            memory_set_caller_tracking(0);
+            shell_print_colored("Call-site tracking disabled\n", COLOR_INFO, BLACK);
+        } else {
+            memory_dump_stats();
+            
+            char buffer[16];
+            shell_print_string("Scratch arena peak: ");
+            itoa(scratch_arena()->peak, buffer);
+            shell_print_string(buffer);
+            shell_print_string(" B\n");
+        }
+    } else if (my_strncmp(subcommand, "map", 3) == 0) {
+        pmm_dump_map();
+        paging_dump_info();
     } else {
-        shell_print_colored("Usage: memory <dump|check|test>\n", COLOR_INFO, BLACK);
+        shell_print_colored("Usage: memory <dump|check|test|slabs|stats|map>\n", COLOR_INFO, BLACK);
     }
 }
 
@@ -482,6 +542,74 @@ static void cmd_hwinfo(char* args __attribute__((unused))) {
     shell_print_string("Detecting hardware components...\n");
     hardware_detection_init();
     display_hardware_info();
+    fbcon_dump_info();
+    serial_dump_info();
+    timer_dump_info();
+    tsc_dump_info();
+    acpi_dump_info();
+    smp_dump_info();
+    task_dump_info();
+}
+
+static void cmd_ps(char* args __attribute__((unused))) {
+    thread_dump_info();
+}
+
+// Job number from "n" or "%n"; 0 if none was given
+static int parse_job_number(const char* args) {
+    int number = 0;
+    if (!args) return 0;
+    if (*args == '%') args++;
+    while (*args >= '0' && *args <= '9') {
+        number = number * 10 + (*args++ - '0');
+    }
+    return number;
+}
+
+static void cmd_jobs(char* args __attribute__((unused))) {
+    jobs_list();
+}
+
+static void cmd_fg(char* args) {
+    if (job_foreground(parse_job_number(args)) < 0) {
+        shell_print_colored("fg: no such job\n", COLOR_ERROR, BLACK);
+    }
+}
+
+static void cmd_wait(char* args) {
+    if (job_wait(parse_job_number(args)) < 0) {
+        shell_print_colored("wait: no such job\n", COLOR_ERROR, BLACK);
+    }
+}
+
+// Run a command and report how long it took. The command line is copied
+// first since the command handler tokenizes it in place.
+static void cmd_time(char* args) {
+    if (!args) {
+        shell_print_colored("Usage: time <command>\n", COLOR_INFO, BLACK);
+        return;
+    }
+    
+    char line[256];
+    SAFE_STRCPY(line, args, sizeof(line));
+    
+    uint64_t start_cycles = rdtsc();
+    uint64_t start_ns = ktime_ns();
+    int found = process_command(args);
+    uint64_t elapsed_ns = ktime_ns() - start_ns;
+    uint64_t elapsed_cycles = rdtsc() - start_cycles;
+    
+    if (!found) {
+        kprintf_colored(COLOR_ERROR, BLACK, "time: unknown command: %s\n", line);
+        return;
+    }
+    kprintf_colored(COLOR_INFO, BLACK, "\n%s: %llu ns (%llu.%03u ms)",
+                    line, (unsigned long long)elapsed_ns,
+                    (unsigned long long)(elapsed_ns / 1000000), (unsigned int)(elapsed_ns / 1000 % 1000));
+    if (tsc_present()) {
+        kprintf_colored(COLOR_INFO, BLACK, ", %llu cycles", (unsigned long long)elapsed_cycles);
+    }
+    shell_print_char('\n');
 }
 
 static void cmd_write(char* args) {
@@ -668,9 +796,11 @@ static void cmd_debug(char* args) {
     shell_print_char('\n');
     
     shell_print_colored("Current dir: ", COLOR_INFO, BLACK);
-    char current_path[256];
-    get_current_path(current_path);
-    shell_print_colored(current_path, COLOR_DIR, BLACK);
+    char* current_path = (char*)arena_alloc(scratch_arena(), MAX_PATH_LENGTH);
+    if (current_path) {
+        get_current_path(current_path);
+        shell_print_colored(current_path, COLOR_DIR, BLACK);
+    }
     shell_print_char('\n');
     
     shell_print_colored("Searching for file: ", COLOR_INFO, BLACK);
@@ -727,6 +857,11 @@ static const CommandEntry command_table[] = {
     {"fat32", cmd_fat32},
     {"debug", cmd_debug},
     {"memory", cmd_memory},
+    {"time", cmd_time},
+    {"ps", cmd_ps},
+    {"jobs", cmd_jobs},
+    {"fg", cmd_fg},
+    {"wait", cmd_wait},
     {NULL, NULL} // End marker
 };
 
@@ -736,6 +871,20 @@ int process_command(char* cmd) {
         return 0;
     }
     
+    // A trailing '&' runs the line as a background job
+    size_t length = strlen(cmd);
+    while (length > 0 && cmd[length - 1] == ' ') length--;
+    if (length > 0 && cmd[length - 1] == '&') {
+        cmd[--length] = '\0';
+        while (length > 0 && cmd[length - 1] == ' ') cmd[--length] = '\0';
+        if (length == 0) {
+            shell_print_colored("Usage: <command> &\n", COLOR_INFO, BLACK);
+        } else {
+            job_start(cmd);
+        }
+        return 1;
+    }
+    
     char* saveptr;
     char* command = strtok_r(cmd, " ", &saveptr);
     char* args = saveptr; // Remaining arguments
@@ -753,7 +902,11 @@ int process_command(char* cmd) {
     // Search for command in table - use exact match instead of partial match
     for (int i = 0; command_table[i].name != NULL; i++) {
         if (strcmp(command, command_table[i].name) == 0) {
+            // Scratch allocations made by the handler are dropped in one go
+            arena_t* scratch = scratch_arena();
+            arena_mark_t mark = arena_mark(scratch);
             command_table[i].handler(args);
+            arena_release(scratch, mark);
             return 1; // Command found and executed
         }
     }
@@ -1,13 +1,95 @@
 #include "display.h"
 #include "io.h"
+#include "paging.h"
+#include "string_utils.h"
+#include "scrollback.h"
+#include "fbcon.h"
+#include "serial.h"
+#include "kprintf.h"
+#include "thread.h"
 
-// Global variables
+#define ESCAPE_MAX_LENGTH 16         // Bytes kept of one control sequence
+#define ESCAPE_MAX_PARAMS 8
+
+// Escape parser states
+#define ESCAPE_NONE 0
+#define ESCAPE_START 1              // Seen ESC
+#define ESCAPE_CSI 2                // Seen ESC [
+
+#define DEFAULT_ATTRIBUTE ((BLACK << 4) | WHITE)
+
+// Global variables: cursor and colours of the console receiving output
 int cursor_x = 0;
 int cursor_y = 0;
 int current_fg_color = WHITE;
 int current_bg_color = BLACK;
 
+// One virtual terminal.
+//
+// All output lands in the RAM copy of the screen first. Each row keeps the
+// span [dirty_start, dirty_end) that differs from video memory, and a flush
+// copies just those spans out. The rows form a ring starting at shadow_top,
+// so scrolling never moves the shadow contents. The grid is 80x25 in text
+// mode and sized to the screen on a framebuffer.
+//
+// Hardware scrolling: in text mode each terminal owns VT_TEXT_ROWS rows of
+// the 32KB text memory, and its screen is a window into them starting at
+// row vga_origin. Scrolling moves the window down through the CRTC start
+// address; only when it reaches the end of the terminal's rows is the
+// screen copied back to the top. Background terminals keep drawing into
+// their own rows, so switching terminals only reprograms the start address.
+typedef struct {
+    VideoChar shadow[CONSOLE_MAX_COLS * CONSOLE_MAX_ROWS];
+    unsigned short dirty_start[CONSOLE_MAX_ROWS];
+    unsigned short dirty_end[CONSOLE_MAX_ROWS];
+    int any_dirty;
+    int shadow_top;
+    int vga_origin;
+    int origin_changed;
+    int pending_scroll;             // Framebuffer scrolls not yet applied
+    int cursor_x;                   // Saved cursor and colours while another
+    int cursor_y;                   // terminal receives output
+    int fg_color;
+    int bg_color;
+    int ready;                      // Cleared at least once
+    int escape_state;               // Control sequence being parsed
+    int escape_length;
+    char escape_bytes[ESCAPE_MAX_LENGTH];
+    scrollback_t history;
+} console_t;
+
+static console_t consoles[VT_COUNT];
+static console_t* output = &consoles[0];    // Receives output; owns the globals above
+static console_t* shown = &consoles[0];     // On screen
+
+static int screen_cols = VGA_WIDTH;
+static int screen_rows = VGA_HEIGHT;
+static int hw_cursor_pos = -1;      // Last position sent to the CRTC
+
+// Lines the shown terminal is scrolled back into history; 0 shows it live
+static int view_offset = 0;
+
+// Framebuffer backend: scrolls are batched into one move of the pixels at
+// flush time, and the cursor is an underline drawn into its cell.
+static int use_framebuffer = 0;
+static int fb_cursor_x = 0;
+static int fb_cursor_y = -1;        // Row holding the drawn cursor, -1 if none
+static int fb_cursor_hidden = 0;
+
+// VGA colour index <-> ANSI colour number (the red and blue bits swap)
+static const unsigned char vga_ansi_color[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+// Attribute the serial terminal is drawing with. Colours chosen with
+// set_color() are sent to it as SGR sequences before the next character.
+static unsigned char serial_attribute = DEFAULT_ATTRIBUTE;
+
+static inline VideoChar* console_cell(console_t* console, int x, int y);
+
 void enable_cursor(unsigned char cursor_start, unsigned char cursor_end) {
+    if (use_framebuffer) {
+        fb_cursor_hidden = 0;
+        return;
+    }
     outb(0x3D4, 0x0A);
     outb(0x3D5, (inb(0x3D5) & 0xC0) | cursor_start);
     outb(0x3D4, 0x0B);
@@ -15,57 +97,595 @@ void enable_cursor(unsigned char cursor_start, unsigned char cursor_end) {
 }
 
 void disable_cursor() {
+    if (use_framebuffer) {
+        if (fb_cursor_y >= 0) fbcon_draw(fb_cursor_y, fb_cursor_x, console_cell(shown, fb_cursor_x, fb_cursor_y), 1);
+        fb_cursor_y = -1;
+        fb_cursor_hidden = 1;
+        return;
+    }
     outb(0x3D4, 0x0A);
     outb(0x3D5, 0x20);
 }
 
+// First text memory row of a terminal
+static inline int console_base(console_t* console) {
+    return (console - consoles) * VT_TEXT_ROWS;
+}
+
+// Place the cursor of the shown terminal
 void update_cursor(int x, int y) {
-    unsigned short pos = y * VGA_WIDTH + x;
+    // Text memory is write-combining; push buffered characters out first
+    paging_flush_wc();
+    
+    if (use_framebuffer) {
+        if (x >= screen_cols) x = screen_cols - 1;
+        if (fb_cursor_y >= 0 && (fb_cursor_x != x || fb_cursor_y != y)) {
+            fbcon_draw(fb_cursor_y, fb_cursor_x, console_cell(shown, fb_cursor_x, fb_cursor_y), 1);
+        }
+        fb_cursor_x = x;
+        fb_cursor_y = y;
+        if (!fb_cursor_hidden) fbcon_draw_cursor(y, x, console_cell(shown, x, y));
+        paging_flush_wc();
+        return;
+    }
+    
+    int pos = (console_base(shown) + shown->vga_origin + y) * VGA_WIDTH + x;
+    if (pos == hw_cursor_pos) return;
+    hw_cursor_pos = pos;
+    
     outb(0x3D4, 0x0F);
     outb(0x3D5, (unsigned char)(pos & 0xFF));
     outb(0x3D4, 0x0E);
     outb(0x3D5, (unsigned char)((pos >> 8) & 0xFF));
 }
 
+// Program the CRTC start address (registers 0x0C/0x0D), in cells
+static void set_start_address(unsigned short offset) {
+    outb(0x3D4, 0x0C);
+    outb(0x3D5, (unsigned char)((offset >> 8) & 0xFF));
+    outb(0x3D4, 0x0D);
+    outb(0x3D5, (unsigned char)(offset & 0xFF));
+}
+
+// Index of a screen row inside a terminal's shadow ring
+static inline int ring_row(console_t* console, int row) {
+    row += console->shadow_top;
+    return row >= screen_rows ? row - screen_rows : row;
+}
+
+static inline VideoChar* console_cell(console_t* console, int x, int y) {
+    return &console->shadow[ring_row(console, y) * screen_cols + x];
+}
+
+static inline VideoChar* shadow_cell(int x, int y) {
+    return console_cell(output, x, y);
+}
+
+static inline unsigned short blank_cell(void) {
+    return (((current_bg_color << 4) | current_fg_color) << 8) | ' ';
+}
+
+// `row` is a shadow ring index
+static void mark_dirty(console_t* console, int row, int start, int end) {
+    if (console->dirty_start[row] >= console->dirty_end[row]) {
+        console->dirty_start[row] = start;
+        console->dirty_end[row] = end;
+    } else {
+        if (start < console->dirty_start[row]) console->dirty_start[row] = start;
+        if (end > console->dirty_end[row]) console->dirty_end[row] = end;
+    }
+    console->any_dirty = 1;
+}
+
+static void mark_all_dirty(console_t* console) {
+    for (int row = 0; row < screen_rows; row++) {
+        console->dirty_start[row] = 0;
+        console->dirty_end[row] = screen_cols;
+    }
+    console->any_dirty = 1;
+}
+
+// Copy one dirty span of ring row `row` to the screen
+static void draw_span(console_t* console, int row, int start, int end) {
+    int screen_row = row - console->shadow_top;
+    if (screen_row < 0) screen_row += screen_rows;
+    const VideoChar* source = console->shadow + row * screen_cols + start;
+    
+    if (use_framebuffer) {
+        fbcon_draw(screen_row, start, source, end - start);
+    } else {
+        VideoChar* video = VIDEO_MEMORY + (console_base(console) + console->vga_origin + screen_row) * VGA_WIDTH;
+        memcpy(video + start, source, (end - start) * sizeof(VideoChar));
+    }
+}
+
+// Apply the scrolls since the last flush by redrawing every row from the
+// shadow. Moving the pixels instead would read the write-combined
+// framebuffer back, which is uncached and slower than the glyph cache.
+static void flush_pending_scroll(console_t* console) {
+    if (!console->pending_scroll) return;
+    
+    mark_all_dirty(console);
+    fb_cursor_y = -1;               // Drawn over with the rest
+    console->pending_scroll = 0;
+}
+
+// Copy a terminal's dirty spans to its video memory. Only the shown
+// terminal pans the screen and moves the cursor. A framebuffer holds just
+// the shown terminal, so the others are redrawn in full when switched to.
+static void flush_console(console_t* console) {
+    if (use_framebuffer) {
+        if (console != shown) {
+            console->pending_scroll = 0;
+            return;
+        }
+        flush_pending_scroll(console);
+    }
+    
+    if (console->any_dirty) {
+        for (int row = 0; row < screen_rows; row++) {
+            int start = console->dirty_start[row];
+            int end = console->dirty_end[row];
+            if (start >= end) continue;
+            
+            draw_span(console, row, start, end);
+            console->dirty_start[row] = screen_cols;
+            console->dirty_end[row] = 0;
+        }
+        console->any_dirty = 0;
+    }
+    if (console != shown) return;
+    
+    // Pan only after the rows under the new window are in place
+    if (console->origin_changed && !use_framebuffer) {
+        set_start_address((console_base(console) + console->vga_origin) * VGA_WIDTH);
+        console->origin_changed = 0;
+    }
+    if (console == output) {
+        update_cursor(cursor_x, cursor_y);
+    } else {
+        update_cursor(console->cursor_x, console->cursor_y);
+    }
+}
+
+// Return the shown terminal from history to its live screen
+static void leave_view(void) {
+    view_offset = 0;
+    mark_all_dirty(shown);
+    enable_cursor(14, 15);
+}
+
+// Copy dirty spans to the screen and move the cursor once
+void display_flush(void) {
+    // New output returns a scrolled-back view to the live screen
+    if (view_offset && output == shown) leave_view();
+    flush_console(output);
+}
+
+// Draw the window `view_offset` lines back: history rows first, then the
+// top of the live screen. Only the visible rows are decoded.
+static void draw_view(void) {
+    VideoChar row[CONSOLE_MAX_COLS];
+    int history = scrollback_count(&shown->history);
+    
+    // Scrolls still owed to the framebuffer are overdrawn here; the live
+    // screen is redrawn in full on return anyway
+    shown->pending_scroll = 0;
+    
+    for (int i = 0; i < screen_rows; i++) {
+        int line = history - view_offset + i;
+        const VideoChar* source = row;
+        if (line < history) {
+            scrollback_get(&shown->history, line, row, screen_cols);
+        } else {
+            source = shown->shadow + ring_row(shown, line - history) * screen_cols;
+        }
+        if (use_framebuffer) {
+            fbcon_draw(i, 0, source, screen_cols);
+        } else {
+            VideoChar* video = VIDEO_MEMORY + (console_base(shown) + shown->vga_origin + i) * VGA_WIDTH;
+            memcpy(video, source, VGA_WIDTH * sizeof(VideoChar));
+        }
+    }
+    paging_flush_wc();
+}
+
+// Move the view through history; positive goes back (Shift+PgUp)
+void display_scroll_view(int lines) {
+    preempt_disable();
+    int offset = view_offset + lines;
+    int history = scrollback_count(&shown->history);
+    if (offset > history) offset = history;
+    if (offset < 0) offset = 0;
+    if (offset == 0) {
+        display_view_live();
+    } else if (offset != view_offset) {
+        if (view_offset == 0) disable_cursor();
+        view_offset = offset;
+        draw_view();
+    }
+    preempt_enable();
+}
+
+// Leave history view, if active
+void display_view_live(void) {
+    preempt_disable();
+    if (view_offset) {
+        leave_view();
+        flush_console(shown);
+    }
+    preempt_enable();
+}
+
+// Make `console` the one receiving output, swapping the global cursor and
+// colours. A terminal that has never been used starts cleared.
+static void set_output(console_t* console) {
+    output->cursor_x = cursor_x;
+    output->cursor_y = cursor_y;
+    output->fg_color = current_fg_color;
+    output->bg_color = current_bg_color;
+    
+    output = console;
+    if (!console->ready) {
+        console->fg_color = WHITE;
+        console->bg_color = BLACK;
+    }
+    cursor_x = console->cursor_x;
+    cursor_y = console->cursor_y;
+    current_fg_color = console->fg_color;
+    current_bg_color = console->bg_color;
+    if (!console->ready) clear_screen();
+}
+
+// Bring terminal `vt` to the screen; output follows it. In text mode this
+// is a page flip, since the terminal's rows are already in video memory.
+void display_switch_vt(int vt) {
+    if (vt < 0 || vt >= VT_COUNT || &consoles[vt] == shown) return;
+    
+    preempt_disable();
+    if (view_offset) leave_view();
+    display_flush();
+    
+    console_t* console = &consoles[vt];
+    shown = console;
+    if (use_framebuffer) {
+        fb_cursor_y = -1;
+        mark_all_dirty(console);
+    } else {
+        console->origin_changed = 1;
+    }
+    set_output(console);
+    flush_console(console);
+    preempt_enable();
+}
+
+// Send output to terminal `vt` without showing it
+void display_set_output_vt(int vt) {
+    if (vt < 0 || vt >= VT_COUNT || &consoles[vt] == output) return;
+    preempt_disable();
+    display_flush();
+    set_output(&consoles[vt]);
+    preempt_enable();
+}
+
+int display_current_vt(void) {
+    return shown - consoles;
+}
+
+// Blank the cursor's line and return to its first column
+void display_clear_line(void) {
+    shell_print_string("\r\033[K");
+}
+
+// Output of a thread with its own sink (a background job) goes there
+static int redirected(const char* text, size_t length) {
+    thread_t* self = thread_current();
+    return self && self->output && self->output(self->output_data, text, length);
+}
+
 void clear_screen() {
-    VideoChar* video = VIDEO_MEMORY;
-    for (int i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) {
-        video[i].character = ' ';
-        video[i].attribute = (BLACK << 4) | WHITE;
+    preempt_disable();
+    if (redirected("", 0)) {
+        preempt_enable();
+        return;
     }
+    serial_write("\033[2J\033[H", 7);
+    memsetw(output->shadow, (((BLACK << 4) | WHITE) << 8) | ' ', screen_cols * screen_rows);
+    mark_all_dirty(output);
+    output->shadow_top = 0;
+    output->vga_origin = 0;
+    output->origin_changed = 1;
+    output->pending_scroll = 0;
+    output->escape_state = ESCAPE_NONE;
+    output->ready = 1;
     cursor_x = 0;
     cursor_y = 0;
-    enable_cursor(14, 15);  // Enable cursor with standard shape
-    update_cursor(cursor_x, cursor_y);
+    if (output == shown) enable_cursor(14, 15);  // Enable cursor with standard shape
+    display_flush();
+    preempt_enable();
 }
 
+// Switch the console to the boot loader's framebuffer, keeping what is on
+// the text screens. Returns 0 (and stays in text mode) if there is none.
+int display_init_framebuffer(const multiboot_info_t* mbi) {
+    if (use_framebuffer || !fbcon_init(mbi)) return 0;
+    
+    disable_cursor();
+    use_framebuffer = 1;
+    int columns = fbcon_columns();
+    int rows = fbcon_rows();
+    if (columns > CONSOLE_MAX_COLS) columns = CONSOLE_MAX_COLS;
+    if (rows > CONSOLE_MAX_ROWS) rows = CONSOLE_MAX_ROWS;
+    
+    // Re-lay each terminal's 80x25 ring as the top left of the new grid
+    VideoChar text[VGA_WIDTH * VGA_HEIGHT];
+    for (int vt = 0; vt < VT_COUNT; vt++) {
+        console_t* console = &consoles[vt];
+        if (!console->ready) continue;
+        
+        for (int y = 0; y < VGA_HEIGHT; y++) {
+            memcpy(text + y * VGA_WIDTH, console_cell(console, 0, y), VGA_WIDTH * sizeof(VideoChar));
+        }
+        memsetw(console->shadow, (((BLACK << 4) | WHITE) << 8) | ' ', columns * rows);
+        for (int y = 0; y < VGA_HEIGHT; y++) {
+            memcpy(console->shadow + y * columns, text + y * VGA_WIDTH, VGA_WIDTH * sizeof(VideoChar));
+        }
+        console->shadow_top = 0;
+        console->pending_scroll = 0;
+    }
+    
+    screen_cols = columns;
+    screen_rows = rows;
+    for (int vt = 0; vt < VT_COUNT; vt++) {
+        mark_all_dirty(&consoles[vt]);
+    }
+    view_offset = 0;
+    fb_cursor_y = -1;
+    fb_cursor_hidden = 0;
+    
+    fbcon_clear();
+    display_flush();
+    return 1;
+}
+
+int display_columns(void) {
+    return screen_cols;
+}
+
+int display_rows(void) {
+    return screen_rows;
+}
+
+// SGR sequence selecting VGA colours fg and bg. The reset leaves our own
+// parser's foreground bright, hence the 22.
+static int sgr_sequence(char* sequence, size_t size, int fg, int bg) {
+    return ksnprintf(sequence, size, "\033[0;22;%d;%dm",
+                     (fg & 8 ? 90 : 30) + vga_ansi_color[fg & 7],
+                     (bg & 8 ? 100 : 40) + vga_ansi_color[bg & 7]);
+}
+
+// A redirected thread's colours go into its output, where the ANSI parser
+// picks them up when it is replayed; the console's stay the shell's
 void set_color(int fg, int bg) {
-    current_fg_color = fg;
-    current_bg_color = bg;
+    preempt_disable();
+    thread_t* self = thread_current();
+    if (redirected("", 0)) {
+        char sequence[16];
+        int length = sgr_sequence(sequence, sizeof(sequence), fg, bg);
+        self->output(self->output_data, sequence, length);
+        self->output_fg = fg;
+        self->output_bg = bg;
+    } else {
+        current_fg_color = fg;
+        current_bg_color = bg;
+    }
+    preempt_enable();
 }
 
 void shell_print_colored(const char* str, int fg, int bg) {
-    int old_fg = current_fg_color;
-    int old_bg = current_bg_color;
+    preempt_disable();
+    thread_t* self = thread_current();
+    int redirect = redirected("", 0);
+    int old_fg = redirect ? self->output_fg : current_fg_color;
+    int old_bg = redirect ? self->output_bg : current_bg_color;
     set_color(fg, bg);
     shell_print_string(str);
     set_color(old_fg, old_bg);
+    preempt_enable();
 }
 
+// Scroll up one line: save the top line to the scrollback, rotate the shadow
+// ring and move the hardware window (or queue a framebuffer redraw). Only the
+// new bottom line has to be written, except when the window wraps.
 void scroll_screen() {
-    VideoChar* video = VIDEO_MEMORY;
-    for (int i = 0; i < (VGA_HEIGHT - 1) * VGA_WIDTH; i++) {
-        video[i] = video[i + VGA_WIDTH];
+    scrollback_push(&output->history, output->shadow + output->shadow_top * screen_cols, screen_cols);
+    
+    int bottom = output->shadow_top;
+    output->shadow_top = ring_row(output, 1);
+    memsetw(output->shadow + bottom * screen_cols, blank_cell(), screen_cols);
+    mark_dirty(output, bottom, 0, screen_cols);
+    cursor_y = screen_rows - 1;
+    
+    if (use_framebuffer) {
+        output->pending_scroll++;
+        return;
     }
-    for (int i = (VGA_HEIGHT - 1) * VGA_WIDTH; i < VGA_HEIGHT * VGA_WIDTH; i++) {
-        video[i].character = ' ';
-        video[i].attribute = (current_bg_color << 4) | current_fg_color;
+    
+    output->vga_origin++;
+    if (output->vga_origin + VGA_HEIGHT > VT_TEXT_ROWS) {
+        output->vga_origin = 0;
+        mark_all_dirty(output);
     }
-    cursor_y = VGA_HEIGHT - 1;
+    output->origin_changed = 1;
 }
 
-void shell_print_char(char c) {
-    VideoChar* video = VIDEO_MEMORY;
+static void serial_sync_attribute(void) {
+    unsigned char attribute = (current_bg_color << 4) | current_fg_color;
+    if (attribute == serial_attribute || !serial_present()) return;
+    serial_attribute = attribute;
+    
+    if (attribute == DEFAULT_ATTRIBUTE) {
+        serial_write("\033[0m", 4);
+        return;
+    }
+    char sequence[16];
+    int length = sgr_sequence(sequence, sizeof(sequence), current_fg_color, current_bg_color);
+    serial_write(sequence, length);
+}
+
+// Blank columns [start, end) of screen row `y` in the current colours
+static void erase_cells(int y, int start, int end) {
+    if (start >= end) return;
+    memsetw(shadow_cell(start, y), blank_cell(), end - start);
+    mark_dirty(output, ring_row(output, y), start, end);
+}
+
+static int clamp(int value, int low, int high) {
+    if (value < low) return low;
+    if (value > high) return high;
+    return value;
+}
+
+// SGR: 0 reset, 1/22 bright on/off, 30-37/90-97 foreground, 39 default
+// foreground, 40-47/100-107 background, 49 default background
+static void select_graphic_rendition(const int* params, int count) {
+    if (count == 0) count = 1;      // "ESC [ m" is a reset
+    
+    for (int i = 0; i < count; i++) {
+        int p = params[i];
+        if (p == 0) {
+            current_fg_color = WHITE;
+            current_bg_color = BLACK;
+        } else if (p == 1) {
+            current_fg_color |= 8;
+        } else if (p == 22) {
+            current_fg_color &= 7;
+        } else if (p >= 30 && p <= 37) {
+            current_fg_color = (current_fg_color & 8) | vga_ansi_color[p - 30];
+        } else if (p >= 90 && p <= 97) {
+            current_fg_color = 8 | vga_ansi_color[p - 90];
+        } else if (p == 39) {
+            current_fg_color = WHITE;
+        } else if (p >= 40 && p <= 47) {
+            current_bg_color = vga_ansi_color[p - 40];
+        } else if (p >= 100 && p <= 107) {
+            current_bg_color = 8 | vga_ansi_color[p - 100];
+        } else if (p == 49) {
+            current_bg_color = BLACK;
+        }
+    }
+}
+
+// Run a complete CSI sequence held in escape_bytes ("[" params final)
+static void execute_csi(void) {
+    int params[ESCAPE_MAX_PARAMS];
+    int count = 0;
+    int length = output->escape_length;
+    char final = output->escape_bytes[length - 1];
+    
+    // Private sequences (ESC [ ? ...) are passed on to the serial side only
+    if (length > 1 && output->escape_bytes[1] == '?') {
+        serial_write("\033", 1);
+        serial_write(output->escape_bytes, length);
+        return;
+    }
+    
+    for (int i = 1; i < length - 1 && count < ESCAPE_MAX_PARAMS; i++) {
+        int value = 0;
+        while (i < length - 1 && output->escape_bytes[i] >= '0' && output->escape_bytes[i] <= '9') {
+            value = value * 10 + (output->escape_bytes[i++] - '0');
+        }
+        params[count++] = value;
+        if (output->escape_bytes[i] != ';') break;
+    }
+    int n = (count > 0 && params[0] > 0) ? params[0] : 1;
+    int mode = count > 0 ? params[0] : 0;
+    
+    switch (final) {
+        case 'A':
+            cursor_y = clamp(cursor_y - n, 0, screen_rows - 1);
+            break;
+        case 'B':
+            cursor_y = clamp(cursor_y + n, 0, screen_rows - 1);
+            break;
+        case 'C':
+            cursor_x = clamp(cursor_x + n, 0, screen_cols - 1);
+            break;
+        case 'D':
+            cursor_x = clamp(cursor_x - n, 0, screen_cols - 1);
+            break;
+        case 'G':
+            cursor_x = clamp(n - 1, 0, screen_cols - 1);
+            break;
+        case 'H':
+        case 'f':
+            cursor_y = clamp(n - 1, 0, screen_rows - 1);
+            cursor_x = clamp((count > 1 && params[1] > 0 ? params[1] : 1) - 1, 0, screen_cols - 1);
+            break;
+        case 'K':
+            if (mode == 0) erase_cells(cursor_y, cursor_x, screen_cols);
+            if (mode == 1) erase_cells(cursor_y, 0, cursor_x + 1);
+            if (mode == 2) erase_cells(cursor_y, 0, screen_cols);
+            break;
+        case 'J':
+            if (mode == 0) {
+                erase_cells(cursor_y, cursor_x, screen_cols);
+                for (int y = cursor_y + 1; y < screen_rows; y++) erase_cells(y, 0, screen_cols);
+            } else if (mode == 1) {
+                for (int y = 0; y < cursor_y; y++) erase_cells(y, 0, screen_cols);
+                erase_cells(cursor_y, 0, cursor_x + 1);
+            } else {
+                for (int y = 0; y < screen_rows; y++) erase_cells(y, 0, screen_cols);
+            }
+            break;
+        case 'm':
+            select_graphic_rendition(params, count);
+            return;                 // Colours reach the serial side lazily
+    }
+    
+    // Erasing paints with the background colour, so bring that over first
+    serial_sync_attribute();
+    serial_write("\033", 1);
+    serial_write(output->escape_bytes, length);
+}
+
+// Feed one byte of an escape sequence (the ESC included) to the parser
+static void parse_escape(char c) {
+    console_t* console = output;
+    
+    if (c == '\033') {
+        console->escape_state = ESCAPE_START;
+        console->escape_length = 0;
+        return;
+    }
+    if (console->escape_state == ESCAPE_START) {
+        // Only CSI sequences are supported; anything else is dropped
+        console->escape_state = c == '[' ? ESCAPE_CSI : ESCAPE_NONE;
+        console->escape_bytes[console->escape_length++] = c;
+        return;
+    }
+    
+    if (console->escape_length == ESCAPE_MAX_LENGTH) {
+        console->escape_state = ESCAPE_NONE;
+        return;
+    }
+    console->escape_bytes[console->escape_length++] = c;
+    if (c >= 0x40 && c <= 0x7E) {
+        console->escape_state = ESCAPE_NONE;
+        execute_csi();
+    }
+}
+
+// Put one character into the shadow buffer without touching the hardware.
+// ANSI control sequences are interpreted here, so coloured text can be
+// printed as one string.
+static void put_char(char c) {
+    if (c == '\033' || output->escape_state != ESCAPE_NONE) {
+        parse_escape(c);
+        return;
+    }
+    if (c != '\n') serial_sync_attribute();
+    serial_put_char(c);
     
     if (c == '\n') {
         cursor_x = 0;
@@ -75,77 +695,72 @@ void shell_print_char(char c) {
     } else if (c == '\b') {
         if (cursor_x > 0) {
             cursor_x--;
-            video[cursor_y * VGA_WIDTH + cursor_x].character = ' ';
-            video[cursor_y * VGA_WIDTH + cursor_x].attribute = (current_bg_color << 4) | current_fg_color;
+            VideoChar* cell = shadow_cell(cursor_x, cursor_y);
+            cell->character = ' ';
+            cell->attribute = (current_bg_color << 4) | current_fg_color;
+            mark_dirty(output, ring_row(output, cursor_y), cursor_x, cursor_x + 1);
         }
     } else if (c == '\t') {
         cursor_x = (cursor_x + 8) & ~(8 - 1);
     } else {
-        video[cursor_y * VGA_WIDTH + cursor_x].character = c;
-        video[cursor_y * VGA_WIDTH + cursor_x].attribute = (current_bg_color << 4) | current_fg_color;
+        VideoChar* cell = shadow_cell(cursor_x, cursor_y);
+        cell->character = c;
+        cell->attribute = (current_bg_color << 4) | current_fg_color;
+        mark_dirty(output, ring_row(output, cursor_y), cursor_x, cursor_x + 1);
         cursor_x++;
     }
     
-    if (cursor_x >= VGA_WIDTH) {
+    if (cursor_x >= screen_cols) {
         cursor_x = 0;
         cursor_y++;
     }
     
-    if (cursor_y >= VGA_HEIGHT) {
+    if (cursor_y >= screen_rows) {
         scroll_screen();
     }
-    
-    update_cursor(cursor_x, cursor_y);
 }
 
-void shell_print_string(const char* str) {
-    while (*str) {
-        shell_print_char(*str++);
+void shell_print_char(char c) {
+    preempt_disable();
+    if (!redirected(&c, 1)) {
+        put_char(c);
+        display_flush();
     }
+    preempt_enable();
 }
 
-void print_int(int value) {
-    if (value == 0) {
-        shell_print_char('0');
-        return;
+// Whole strings are drawn into the shadow buffer and flushed once. The
+// console state is shared by all threads, so no switch happens mid-string.
+void shell_print_string(const char* str) {
+    preempt_disable();
+    if (!redirected(str, strlen(str))) {
+        while (*str) {
+            put_char(*str++);
+        }
+        display_flush();
     }
-    
-    if (value < 0) {
-        shell_print_char('-');
-        value = -value;
+    preempt_enable();
+}
+
+void shell_print_buffer(const char* str, size_t length) {
+    preempt_disable();
+    if (!redirected(str, length)) {
+        for (size_t i = 0; i < length; i++) {
+            put_char(str[i]);
+        }
+        display_flush();
     }
-    
+    preempt_enable();
+}
+
+void print_int(int value) {
     char buffer[12]; // Enough for 32-bit int
-    int i = 0;
-    
-    while (value > 0) {
-        buffer[i++] = '0' + (value % 10);
-        value /= 10;
-    }
-    
-    // Print in reverse order
-    for (int j = i - 1; j >= 0; j--) {
-        shell_print_char(buffer[j]);
-    }
+    itoa(value, buffer);
+    shell_print_string(buffer);
 }
 
 void print_hex(unsigned int value) {
-    const char hex_chars[] = "0123456789ABCDEF";
     char buffer[9]; // 8 hex digits + null terminator
-    int i = 0;
-    
-    if (value == 0) {
-        shell_print_char('0');
-        return;
-    }
-    
-    while (value > 0) {
-        buffer[i++] = hex_chars[value & 0xF];
-        value >>= 4;
-    }
-    
-    // Print in reverse order
-    for (int j = i - 1; j >= 0; j--) {
-        shell_print_char(buffer[j]);
-    }
+    itoa_hex(value, buffer);
+    shell_print_string(buffer);
 }
\ No newline at end of file
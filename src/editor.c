@@ -51,10 +51,7 @@ int editor_save() {
     }
     
     SAFE_STRCPY(filesystem[editor_file_index].content, editor_buffer, MAX_CONTENT);
-    filesystem[editor_file_index].size = 0;
-    while (editor_buffer[filesystem[editor_file_index].size]) {
-        filesystem[editor_file_index].size++;
-    }
+    filesystem[editor_file_index].size = strlen(editor_buffer);
     
     shell_print_colored("File saved\n", COLOR_SUCCESS, BLACK);
     return 0;
@@ -68,10 +65,7 @@ int editor_save_and_close() {
     }
     
     SAFE_STRCPY(filesystem[editor_file_index].content, editor_buffer, MAX_CONTENT);
-    filesystem[editor_file_index].size = 0;
-    while (editor_buffer[filesystem[editor_file_index].size]) {
-        filesystem[editor_file_index].size++;
-    }
+    filesystem[editor_file_index].size = strlen(editor_buffer);
     
     shell_print_colored("File saved and editor closed\n", COLOR_SUCCESS, BLACK);
     editor_file_index = -1;
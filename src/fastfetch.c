@@ -2,6 +2,9 @@
 #include "display.h"
 #include "string_utils.h"
 #include "hardware_detection.h"
+#include "kprintf.h"
+#include "timer.h"
+#include "smp.h"
 
 // Get system information
 SystemInfo get_system_info() {
@@ -13,7 +16,7 @@ SystemInfo get_system_info() {
     SAFE_STRCPY(info.kernel_version, "4.1.0", sizeof(info.kernel_version));
     SAFE_STRCPY(info.hostname, "oszoOS-PC", sizeof(info.hostname));
     SAFE_STRCPY(info.architecture, "x86_32", sizeof(info.architecture));
-    info.uptime = 3600; // 1 hour for demo
+    info.uptime = timer_uptime_seconds();
     
     // CPU info from real hardware detection - using all available data
     if (hw_info && hw_info->cpu.vendor[0] != '\0') {
@@ -23,14 +26,14 @@ SystemInfo get_system_info() {
         } else {
             SAFE_STRCPY(info.cpu.brand, "Unknown CPU", sizeof(info.cpu.brand));
         }
-        info.cpu.cores = 1; // Single core detection
-        info.cpu.threads = 1;
+        info.cpu.cores = smp_cpu_count();
+        info.cpu.threads = smp_cpu_count();
         info.cpu.frequency = 0; // Frequency not detected in current implementation
     } else {
         SAFE_STRCPY(info.cpu.vendor, "Unknown", sizeof(info.cpu.vendor));
         SAFE_STRCPY(info.cpu.brand, "Unknown CPU", sizeof(info.cpu.brand));
-        info.cpu.cores = 1;
-        info.cpu.threads = 1;
+        info.cpu.cores = smp_cpu_count();
+        info.cpu.threads = smp_cpu_count();
         info.cpu.frequency = 0;
     }
     
@@ -84,32 +87,7 @@ SystemInfo get_system_info() {
 
 // Helper function to format memory sizes
 void format_memory_size(uint64_t size, char* buffer) {
-    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
-    int unit_index = 0;
-    long double display_size = (long double)size;
-    
-    while (display_size >= 1024.0L && unit_index < 4) {
-        display_size /= 1024.0L;
-        unit_index++;
-    }
-    
-    if (unit_index == 0) {
-        itoa((uint32_t)display_size, buffer);
-    } else {
-        // Format with one decimal place
-        uint32_t whole = (uint32_t)display_size;
-        uint32_t fraction = (uint32_t)((display_size - whole) * 10.0L);
-        
-        char whole_str[16];
-        itoa(whole, whole_str);
-        char fraction_str[8];
-        itoa(fraction, fraction_str);
-        
-        SAFE_STRCPY(buffer, whole_str, 32);
-        SAFE_STRCAT(buffer, ".", 32);
-        SAFE_STRCAT(buffer, fraction_str, 32);
-        SAFE_STRCAT(buffer, units[unit_index], 32);
-    }
+    kformat_size(size, buffer, 32);
 }
 
 // Display enhanced fastfetch-style system information
@@ -130,101 +108,58 @@ void display_fastfetch_style() {
     
     // Enhanced System Information
     shell_print_colored("OS: ", LIGHT_GREEN, BLACK);
-    shell_print_string(info.os_name);
-    shell_print_string(" ");
-    shell_print_string(info.kernel_version);
-    shell_print_char('\n');
+    kprintf("%s %s\n", info.os_name, info.kernel_version);
     
     shell_print_colored("Host: ", LIGHT_GREEN, BLACK);
-    shell_print_string(info.hostname);
-    shell_print_char('\n');
+    kprintf("%s\n", info.hostname);
     
     shell_print_colored("Kernel: ", LIGHT_GREEN, BLACK);
-    shell_print_string(info.architecture);
-    shell_print_char('\n');
+    kprintf("%s\n", info.architecture);
     
     shell_print_colored("Uptime: ", LIGHT_GREEN, BLACK);
-    itoa(info.uptime / 3600, buffer);
-    shell_print_string(buffer);
-    shell_print_string("h ");
-    itoa((info.uptime % 3600) / 60, buffer);
-    shell_print_string(buffer);
-    shell_print_string("m\n");
+    kprintf("%uh %um\n", (unsigned int)(info.uptime / 3600), (unsigned int)((info.uptime % 3600) / 60));
     
     shell_print_colored("CPU: ", LIGHT_GREEN, BLACK);
-    shell_print_string(info.cpu.brand);
-    shell_print_string(" (");
-    shell_print_string(info.cpu.vendor);
-    shell_print_string(")\n");
+    kprintf("%s (%s)\n", info.cpu.brand, info.cpu.vendor);
     
     // Additional CPU details from hardware detection
     HardwareInfo* hw_info = get_hardware_info();
     if (hw_info && hw_info->cpu.vendor[0] != '\0') {
         shell_print_colored("CPU Details: ", LIGHT_GREEN, BLACK);
-        shell_print_string("Family ");
-        itoa(hw_info->cpu.family, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" Model ");
-        itoa(hw_info->cpu.model, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" Stepping ");
-        itoa(hw_info->cpu.stepping, buffer);
-        shell_print_string(buffer);
-        shell_print_string("\n");
+        kprintf("Family %u Model %u Stepping %u\n",
+                hw_info->cpu.family, hw_info->cpu.model, hw_info->cpu.stepping);
         
         shell_print_colored("CPU Features: ", LIGHT_GREEN, BLACK);
-        if (hw_info->cpu.features.sse) shell_print_string("SSE ");
-        if (hw_info->cpu.features.sse2) shell_print_string("SSE2 ");
-        if (hw_info->cpu.features.sse3) shell_print_string("SSE3 ");
-        if (hw_info->cpu.features.ssse3) shell_print_string("SSSE3 ");
-        if (hw_info->cpu.features.sse4_1) shell_print_string("SSE4.1 ");
-        if (hw_info->cpu.features.sse4_2) shell_print_string("SSE4.2 ");
-        shell_print_string("\n");
+        kprintf("%s%s%s%s%s%s\n",
+                hw_info->cpu.features.sse ? "SSE " : "",
+                hw_info->cpu.features.sse2 ? "SSE2 " : "",
+                hw_info->cpu.features.sse3 ? "SSE3 " : "",
+                hw_info->cpu.features.ssse3 ? "SSSE3 " : "",
+                hw_info->cpu.features.sse4_1 ? "SSE4.1 " : "",
+                hw_info->cpu.features.sse4_2 ? "SSE4.2 " : "");
     }
     
-    shell_print_colored("Memory: ", LIGHT_GREEN, BLACK);
-    format_memory_size(info.memory.used_ram, buffer);
-    shell_print_string(buffer);
-    shell_print_string(" / ");
-    format_memory_size(info.memory.total_ram, buffer);
-    shell_print_string(buffer);
-    shell_print_string(" (");
+    char total[32];
     uint32_t mem_percent = 0;
     if (info.memory.total_ram > 0) {
-        mem_percent = (uint32_t)(((long double)info.memory.used_ram * 100.0L) / (long double)info.memory.total_ram);
+        mem_percent = (uint32_t)(info.memory.used_ram * 100 / info.memory.total_ram);
     }
-    itoa((int)mem_percent, buffer);
-    shell_print_string(buffer);
-    shell_print_string("%)\n");
+    shell_print_colored("Memory: ", LIGHT_GREEN, BLACK);
+    kprintf("%s / %s (%u%%)\n", kformat_size(info.memory.used_ram, buffer, sizeof(buffer)),
+            kformat_size(info.memory.total_ram, total, sizeof(total)), mem_percent);
     
     shell_print_colored("GPU: ", LIGHT_GREEN, BLACK);
-    shell_print_string(info.gpu.vendor);
-    shell_print_string(" ");
-    shell_print_string(info.gpu.model);
-    shell_print_string(" @ ");
-    itoa(info.gpu.resolution_x, buffer);
-    shell_print_string(buffer);
-    shell_print_string("x");
-    itoa(info.gpu.resolution_y, buffer);
-    shell_print_string(buffer);
-    shell_print_char('\n');
+    kprintf("%s %s @ %ux%u\n", info.gpu.vendor, info.gpu.model,
+            info.gpu.resolution_x, info.gpu.resolution_y);
     
     shell_print_colored("Storage: ", LIGHT_GREEN, BLACK);
-    format_memory_size(info.storage.used_size, buffer);
-    shell_print_string(buffer);
-    shell_print_string(" / ");
-    format_memory_size(info.storage.total_size, buffer);
-    shell_print_string(buffer);
-    shell_print_string(" (");
-    shell_print_string(info.storage.type);
-    shell_print_string(")\n");
+    kprintf("%s / %s (%s)\n", kformat_size(info.storage.used_size, buffer, sizeof(buffer)),
+            kformat_size(info.storage.total_size, total, sizeof(total)), info.storage.type);
     
     // Display PCI devices information from hardware detection
     if (hw_info && hw_info->pci.device_count > 0) {
         shell_print_colored("PCI Devices: ", LIGHT_GREEN, BLACK);
-        itoa(hw_info->pci.device_count, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" found\n");
+        kprintf("%u found\n", hw_info->pci.device_count);
         
         // Show first few important devices
         int shown = 0;
@@ -233,13 +168,8 @@ void display_fastfetch_style() {
                 hw_info->pci.devices[i].class_code == 0x02 || 
                 hw_info->pci.devices[i].class_code == 0x01) {
                 shell_print_colored("  - ", LIGHT_GREEN, BLACK);
-                shell_print_string("Vendor 0x");
-                itoa_hex(hw_info->pci.devices[i].vendor_id, buffer);
-                shell_print_string(buffer);
-                shell_print_string(" Device 0x");
-                itoa_hex(hw_info->pci.devices[i].device_id, buffer);
-                shell_print_string(buffer);
-                shell_print_char('\n');
+                kprintf("Vendor 0x%X Device 0x%X\n",
+                        hw_info->pci.devices[i].vendor_id, hw_info->pci.devices[i].device_id);
                 shown++;
             }
         }
@@ -1,4 +1,6 @@
 #include "fat32.h"
+#include "string_utils.h"
+#include "task.h"
 #include <stddef.h>
 
 // FAT32 Boot Sector Structure
@@ -74,6 +76,8 @@ static unsigned char disk_buffer[512 * 1024]; // 512KB disk simulation
 #define FAT32_ATTR_ARCHIVE     0x20
 #define FAT32_ATTR_LFN         0x0F
 
+#define FAT32_ZERO_CHUNK (64 * 1024) // Bytes of the disk image cleared per task
+
 // Helper Functions
 unsigned int fat32_get_cluster_value(unsigned int cluster) {
     if (cluster >= fat32_fs.total_clusters) return FAT32_CLUSTER_EOC;
@@ -114,12 +118,16 @@ unsigned char* fat32_get_cluster_data(unsigned int cluster) {
     return fat32_fs.data_area + data_offset;
 }
 
+// Clear part of the disk image; run on every CPU by parallel_for()
+static void zero_disk_range(void* arg, uint32_t begin, uint32_t end) {
+    (void)arg;
+    memset(disk_buffer + begin, 0, end - begin);
+}
+
 // FAT32 Initialization
 int fat32_format(unsigned int total_size_kb) {
-    // Clear disk buffer
-    for (unsigned int i = 0; i < sizeof(disk_buffer); i++) {
-        disk_buffer[i] = 0;
-    }
+    // Clear disk buffer, split across the CPUs
+    parallel_for(0, sizeof(disk_buffer), FAT32_ZERO_CHUNK, zero_disk_range, NULL);
     
     // Setup boot sector
     FAT32_BootSector *boot = (FAT32_BootSector*)disk_buffer;
@@ -465,9 +473,7 @@ int fat32_create_directory(const char* dirname, unsigned int parent_cluster) {
     FAT32_DirEntry *new_entries = (FAT32_DirEntry*)new_dir_data;
     
     // Clear directory
-    for (unsigned int i = 0; i < cluster_size; i++) {
-        new_dir_data[i] = 0;
-    }
+    memset(new_dir_data, 0, cluster_size);
     
     // Create "." entry
     for (int i = 0; i < 11; i++) new_entries[0].name[i] = ' ';
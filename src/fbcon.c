@@ -0,0 +1,160 @@
+#include "fbcon.h"
+#include "font8x16.h"
+#include "paging.h"
+#include "string_utils.h"
+#include "kprintf.h"
+
+// Standard VGA 16-colour palette as 0xRRGGBB
+static const uint32_t vga_palette[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+// Shown for characters outside the font
+static const uint8_t missing_glyph[FONT_HEIGHT] = {
+    0x00, 0x00, 0x00, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00, 0x00, 0x00
+};
+
+// One expanded glyph: FONT_HEIGHT rows of FONT_WIDTH pixels
+typedef struct {
+    uint32_t key;                   // 0 = empty, else 0x10000 | attribute << 8 | character
+    uint32_t pixels[FONT_HEIGHT][FONT_WIDTH];
+} glyph_entry_t;
+
+static glyph_entry_t glyph_cache[GLYPH_CACHE_SIZE];
+static uint32_t cache_hits = 0;
+static uint32_t cache_misses = 0;
+
+static uint8_t* framebuffer = 0;
+static uint32_t fb_pitch = 0;
+static uint32_t fb_width = 0;
+static uint32_t fb_height = 0;
+static uint32_t palette[16];        // In the framebuffer's pixel format
+
+// Scale an 8-bit channel into a field of the pixel
+static uint32_t pack_channel(uint32_t value, int position, int size) {
+    return (value >> (8 - size)) << position;
+}
+
+int fbcon_init(const multiboot_info_t* mbi) {
+    if (!mbi || !(mbi->flags & MULTIBOOT_INFO_FRAMEBUFFER)) return 0;
+    if (mbi->framebuffer_type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB) return 0;
+    if (mbi->framebuffer_bpp != 32) return 0;
+    if (mbi->framebuffer_addr >> 32) return 0;
+    if (mbi->framebuffer_width < FONT_WIDTH * VGA_WIDTH ||
+        mbi->framebuffer_height < FONT_HEIGHT * VGA_HEIGHT) {
+        return 0;
+    }
+    
+    uint32_t address = (uint32_t)mbi->framebuffer_addr;
+    uint32_t size = mbi->framebuffer_pitch * mbi->framebuffer_height;
+    if (!paging_map_wc(address, size)) return 0;
+    
+    framebuffer = (uint8_t*)address;
+    fb_pitch = mbi->framebuffer_pitch;
+    fb_width = mbi->framebuffer_width;
+    fb_height = mbi->framebuffer_height;
+    
+    // color_info: red position/size, green position/size, blue position/size
+    const uint8_t* info = mbi->color_info;
+    for (int i = 0; i < 16; i++) {
+        uint32_t rgb = vga_palette[i];
+        palette[i] = pack_channel((rgb >> 16) & 0xFF, info[0], info[1]) |
+                     pack_channel((rgb >> 8) & 0xFF, info[2], info[3]) |
+                     pack_channel(rgb & 0xFF, info[4], info[5]);
+    }
+    
+    memset(glyph_cache, 0, sizeof(glyph_cache));
+    return 1;
+}
+
+int fbcon_columns(void) {
+    return fb_width / FONT_WIDTH;
+}
+
+int fbcon_rows(void) {
+    return fb_height / FONT_HEIGHT;
+}
+
+// Expanded pixels for a cell, rasterized on first use
+static const glyph_entry_t* lookup_glyph(const VideoChar* cell) {
+    unsigned char character = (unsigned char)cell->character;
+    unsigned char attribute = cell->attribute;
+    uint32_t key = 0x10000 | (attribute << 8) | character;
+    glyph_entry_t* entry = &glyph_cache[(character + attribute * 97) & (GLYPH_CACHE_SIZE - 1)];
+    
+    if (entry->key == key) {
+        cache_hits++;
+        return entry;
+    }
+    cache_misses++;
+    
+    const uint8_t* bits = missing_glyph;
+    if (character >= FONT_FIRST_CHAR && character <= FONT_LAST_CHAR) {
+        bits = font8x16[character - FONT_FIRST_CHAR];
+    }
+    uint32_t fg = palette[attribute & 0x0F];
+    uint32_t bg = palette[(attribute >> 4) & 0x0F];
+    
+    for (int y = 0; y < FONT_HEIGHT; y++) {
+        for (int x = 0; x < FONT_WIDTH; x++) {
+            entry->pixels[y][x] = (bits[y] & (0x80 >> x)) ? fg : bg;
+        }
+    }
+    entry->key = key;
+    return entry;
+}
+
+void fbcon_draw(int row, int col, const VideoChar* cells, int count) {
+    const glyph_entry_t* glyphs[CONSOLE_MAX_COLS];
+    if (count > CONSOLE_MAX_COLS) count = CONSOLE_MAX_COLS;
+    for (int i = 0; i < count; i++) {
+        glyphs[i] = lookup_glyph(&cells[i]);
+    }
+    
+    // Fill the span one pixel row at a time so stores stay sequential for
+    // the write-combining buffers
+    uint8_t* line = framebuffer + row * FONT_HEIGHT * fb_pitch + col * FONT_WIDTH * 4;
+    for (int y = 0; y < FONT_HEIGHT; y++) {
+        uint32_t* dst = (uint32_t*)line;
+        for (int i = 0; i < count; i++) {
+            const uint32_t* src = glyphs[i]->pixels[y];
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = src[3];
+            dst[4] = src[4];
+            dst[5] = src[5];
+            dst[6] = src[6];
+            dst[7] = src[7];
+            dst += FONT_WIDTH;
+        }
+        line += fb_pitch;
+    }
+}
+
+void fbcon_draw_cursor(int row, int col, const VideoChar* cell) {
+    fbcon_draw(row, col, cell, 1);
+    
+    uint32_t color = palette[cell->attribute & 0x0F];
+    for (int y = FONT_HEIGHT - 2; y < FONT_HEIGHT; y++) {
+        uint32_t* dst = (uint32_t*)(framebuffer + (row * FONT_HEIGHT + y) * fb_pitch) + col * FONT_WIDTH;
+        for (int x = 0; x < FONT_WIDTH; x++) {
+            dst[x] = color;
+        }
+    }
+}
+
+void fbcon_clear(void) {
+    memset(framebuffer, 0, fb_pitch * fb_height);
+}
+
+void fbcon_dump_info(void) {
+    if (!framebuffer) {
+        kprintf("Framebuffer: not in use (VGA text mode)\n");
+        return;
+    }
+    kprintf("Framebuffer: %ux%ux32 at %p, %dx%d text\n",
+            fb_width, fb_height, framebuffer, fbcon_columns(), fbcon_rows());
+    kprintf("Glyph cache: %u hits, %u misses\n", cache_hits, cache_misses);
+}
@@ -33,7 +33,7 @@ void init_filesystem() {
 
 void get_current_path(char* buffer) {
     if (current_dir == 0) {
-        SAFE_STRCPY(buffer, "/", 256);
+        SAFE_STRCPY(buffer, "/", MAX_PATH_LENGTH);
         return;
     }
     
@@ -50,8 +50,8 @@ void get_current_path(char* buffer) {
         dir = filesystem[dir].parent_dir;
     }
     
-    SAFE_STRCPY(buffer, temp_path, 256);
-    if (buffer[0] == '\0') SAFE_STRCPY(buffer, "/", 256);
+    SAFE_STRCPY(buffer, temp_path, MAX_PATH_LENGTH);
+    if (buffer[0] == '\0') SAFE_STRCPY(buffer, "/", MAX_PATH_LENGTH);
 }
 
 int find_entry(const char* name) {
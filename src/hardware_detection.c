@@ -2,8 +2,14 @@
 #include "io.h"
 #include "display.h"
 #include "string_utils.h"
+#include "pmm.h"
+#include "arena.h"
+#include "kprintf.h"
 #include <stdint.h>
 
+// Room for the hardware report: header plus one line per PCI device
+#define HARDWARE_REPORT_SIZE (512 + MAX_PCI_DEVICES * 48)
+
 // Global hardware info structure
 HardwareInfo hw_info;
 
@@ -16,16 +22,17 @@ void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t
     );
 }
 
-// Detect CPU information using CPUID - improved version with debugging
-void detect_cpu_info() {
-    uint32_t eax, ebx, ecx, edx;
-    
-    // Clear CPU info first
-    memset(&hw_info.cpu, 0, sizeof(CPUInfo));
-    
-    shell_print_string("[CPU] Starting CPU detection...\n");
-    
-    // Check if CPUID is supported
+// CPUID for leaves that take a subleaf in ECX
+void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ volatile (
+        "cpuid"
+        : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+        : "a"(leaf), "c"(subleaf)
+    );
+}
+
+// CPUID exists if the ID bit in EFLAGS can be toggled
+int cpu_has_cpuid(void) {
     uint32_t flags_before, flags_after;
     __asm__ volatile (
         "pushfl\n\t"
@@ -43,7 +50,55 @@ void detect_cpu_info() {
         : "cc"
     );
     
-    if ((flags_before ^ flags_after) & 0x200000) {
+    return ((flags_before ^ flags_after) & 0x200000) != 0;
+}
+
+// Enhanced REP MOVSB/STOSB (CPUID leaf 7, EBX bit 9)
+int cpu_has_erms(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    if (!cpu_has_cpuid()) return 0;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 7) return 0;
+    
+    cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+    return (ebx >> 9) & 1;
+}
+
+// Turn on SSE (CR0.EM off, CR0.MP and CR4.OSFXSR/OSXMMEXCPT on).
+// Returns 1 if SSE2 instructions may be used afterwards.
+int cpu_enable_sse(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t cr0, cr4;
+    
+    if (!cpu_has_cpuid()) return 0;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    
+    // FXSR (bit 24) is required for OSFXSR
+    if (!((edx >> 24) & 1) || !((edx >> 25) & 1)) return 0;
+    
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~0x4;                    // EM: no x87 emulation
+    cr0 |= 0x2;                     // MP: monitor coprocessor
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(cr0));
+    
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 9) | (1 << 10);    // OSFXSR, OSXMMEXCPT
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(cr4));
+    
+    return (edx >> 26) & 1;
+}
+
+// Detect CPU information using CPUID - improved version with debugging
+void detect_cpu_info() {
+    uint32_t eax, ebx, ecx, edx;
+    
+    // Clear CPU info first
+    memset(&hw_info.cpu, 0, sizeof(CPUInfo));
+    
+    shell_print_string("[CPU] Starting CPU detection...\n");
+    
+    if (cpu_has_cpuid()) {
         // CPUID is supported
         
         // Get CPU vendor string
@@ -99,6 +154,7 @@ void detect_cpu_info() {
         hw_info.cpu.features.ssse3 = (ecx >> 9) & 1;
         hw_info.cpu.features.sse4_1 = (ecx >> 19) & 1;
         hw_info.cpu.features.sse4_2 = (ecx >> 20) & 1;
+        hw_info.cpu.features.erms = cpu_has_erms();
         
         shell_print_string("[CPU] Features - SSE: ");
         print_int(hw_info.cpu.features.sse);
@@ -144,6 +200,18 @@ void detect_cpu_info() {
 
 // Detect memory information using BIOS memory map
 void detect_memory_info() {
+    // Prefer the boot loader memory map when the frame allocator has one
+    if (pmm_get_total_memory() > 0) {
+        hw_info.memory.total_ram = pmm_get_total_memory();
+        hw_info.memory.available_ram = pmm_get_free_memory();
+        hw_info.memory.used_ram = hw_info.memory.total_ram - hw_info.memory.available_ram;
+        
+        shell_print_string("[Memory] Multiboot memory map: ");
+        print_int(hw_info.memory.total_ram / (1024 * 1024));
+        shell_print_string(" MB usable\n");
+        return;
+    }
+    
     // Improved memory detection using multiple methods
     
     // Method 1: Read from CMOS extended memory registers
@@ -293,49 +361,33 @@ HardwareInfo* get_hardware_info() {
 
 // Display hardware information
 void display_hardware_info() {
-    shell_print_string("\n=== Hardware Information ===\n");
-    
-    // Display CPU information
-    shell_print_string("CPU: ");
-    shell_print_string(hw_info.cpu.brand);
-    shell_print_string("\n");
-    
-    shell_print_string("Vendor: ");
-    shell_print_string(hw_info.cpu.vendor);
-    shell_print_string("\n");
-    
-    shell_print_string("Family: ");
-    print_int(hw_info.cpu.family);
-    shell_print_string(" Model: ");
-    print_int(hw_info.cpu.model);
-    shell_print_string("\n");
-    
-    // Display memory information
-    shell_print_string("Memory: ");
-    print_int(hw_info.memory.total_ram / (1024 * 1024));
-    shell_print_string(" MB\n");
-    
-    shell_print_string("Available: ");
-    print_int(hw_info.memory.available_ram / (1024 * 1024));
-    shell_print_string(" MB\n");
+    // Build the whole report first and print it in one pass
+    size_t size = HARDWARE_REPORT_SIZE;
+    char* report = arena_alloc(scratch_arena(), size);
+    if (!report) return;
     
-    // Display PCI devices
-    shell_print_string("PCI Devices: ");
-    print_int(hw_info.pci.device_count);
-    shell_print_string(" found\n");
+    size_t length = ksnprintf(report, size,
+        "\n=== Hardware Information ===\n"
+        "CPU: %s\n"
+        "Vendor: %s\n"
+        "Family: %u Model: %u\n"
+        "Memory: %u MB\n"
+        "Available: %u MB\n"
+        "PCI Devices: %u found\n",
+        hw_info.cpu.brand, hw_info.cpu.vendor,
+        hw_info.cpu.family, hw_info.cpu.model,
+        (unsigned int)(hw_info.memory.total_ram / (1024 * 1024)),
+        (unsigned int)(hw_info.memory.available_ram / (1024 * 1024)),
+        hw_info.pci.device_count);
     
-    for (int i = 0; i < hw_info.pci.device_count; i++) {
+    for (int i = 0; i < hw_info.pci.device_count && length < size; i++) {
         PCIDevice *dev = &hw_info.pci.devices[i];
-        shell_print_string("  Bus ");
-        print_int(dev->bus);
-        shell_print_string(" Device ");
-        print_int(dev->device);
-        shell_print_string(": ");
-        print_hex(dev->vendor_id);
-        shell_print_string(":");
-        print_hex(dev->device_id);
-        shell_print_string("\n");
+        length += ksnprintf(report + length, size - length, "  Bus %u Device %u: %X:%X\n",
+                            dev->bus, dev->device, dev->vendor_id, dev->device_id);
     }
     
-    shell_print_string("============================\n");
+    if (length < size) {
+        ksnprintf(report + length, size - length, "============================\n");
+    }
+    shell_print_string(report);
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "interrupts.h"
+#include "io.h"
+#include "display.h"
+#include "kprintf.h"
+#include "apic.h"
+#include "thread.h"
+
+// 8259 PIC ports and commands
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA 0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI 0x20
+#define PIC_READ_IRR 0x0A
+#define PIC_READ_ISR 0x0B
+#define ICW1_INIT 0x11              // Edge triggered, cascade, ICW4 follows
+#define ICW4_8086 0x01
+
+#define IDT_ENTRIES 256
+#define IDT_INTERRUPT_GATE 0x8E     // Present, ring 0, 32-bit interrupt gate
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) descriptor_pointer_t;
+
+// Flat 4GB code and data segments. GRUB leaves its own GDT loaded, which
+// the Multiboot specification does not promise to keep valid.
+#define GDT_KERNEL_CODE 0x00CF9A000000FFFFULL
+#define GDT_KERNEL_DATA 0x00CF92000000FFFFULL
+#define GDT_TSS_AVAILABLE 0x89ULL       // Present, ring 0, 32-bit TSS
+
+static cpu_descriptors_t boot_descriptors;
+
+static idt_entry_t idt[IDT_ENTRIES];
+static irq_handler_t irq_handlers[IRQ_COUNT];
+static uint16_t irq_mask = 0xFFFF;  // Bit set = line masked; bit 2 is the cascade
+
+// Entry points in isr.asm
+extern uint32_t exception_stub_table[EXCEPTION_COUNT];
+extern uint32_t irq_stub_table[IRQ_COUNT];
+extern void ipi_wakeup_stub(void);
+extern void apic_spurious_stub(void);
+
+// Top of the boot stack, from kernel_entry.asm
+extern char stack_top[];
+
+static const char* const exception_names[EXCEPTION_COUNT] = {
+    "Divide error", "Debug", "Non-maskable interrupt", "Breakpoint",
+    "Overflow", "Bound range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS", "Segment not present",
+    "Stack-segment fault", "General protection fault", "Page fault", "Reserved",
+    "x87 floating-point error", "Alignment check", "Machine check", "SIMD floating-point error",
+    "Virtualization exception", "Control protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved",
+    "Hypervisor injection", "VMM communication", "Security exception", "Reserved"
+};
+
+// Read by the stubs: nonzero when CR4.OSFXSR is set, so handlers can use
+// SSE (the memcpy variants do) without corrupting the interrupted code
+uint32_t interrupt_save_fpu = 0;
+
+// Fill in and load a CPU's GDT, then its TSS
+static void gdt_load(cpu_descriptors_t* descriptors, uint32_t stack_top_address) {
+    tss_t* tss = &descriptors->tss;
+    uint32_t base = (uint32_t)tss;
+    uint32_t limit = sizeof(tss_t) - 1;
+    
+    for (size_t i = 0; i < sizeof(tss_t); i++) ((uint8_t*)tss)[i] = 0;
+    tss->ss0 = KERNEL_DATA_SELECTOR;
+    tss->esp0 = stack_top_address;
+    tss->iomap_base = sizeof(tss_t);    // No I/O permission bitmap
+    
+    descriptors->gdt[0] = 0;
+    descriptors->gdt[1] = GDT_KERNEL_CODE;
+    descriptors->gdt[2] = GDT_KERNEL_DATA;
+    descriptors->gdt[3] = (limit & 0xFFFF) | ((uint64_t)(base & 0xFFFFFF) << 16) |
+                          (GDT_TSS_AVAILABLE << 40) | ((uint64_t)((limit >> 16) & 0xF) << 48) |
+                          ((uint64_t)(base >> 24) << 56);
+    
+    descriptor_pointer_t pointer = { sizeof(descriptors->gdt) - 1, (uint32_t)descriptors->gdt };
+    
+    __asm__ volatile (
+        "lgdt %0\n"
+        "ljmp %1, $1f\n"
+        "1:\n"
+        "mov %2, %%ax\n"
+        "mov %%ax, %%ds\n"
+        "mov %%ax, %%es\n"
+        "mov %%ax, %%fs\n"
+        "mov %%ax, %%gs\n"
+        "mov %%ax, %%ss\n"
+        "mov %3, %%ax\n"
+        "ltr %%ax\n"
+        : : "m"(pointer), "i"(KERNEL_CODE_SELECTOR), "i"(KERNEL_DATA_SELECTOR),
+            "i"(KERNEL_TSS_SELECTOR) : "eax", "memory");
+}
+
+static void idt_load(void) {
+    descriptor_pointer_t pointer = { sizeof(idt) - 1, (uint32_t)idt };
+    __asm__ volatile ("lidt %0" : : "m"(pointer));
+}
+
+static void idt_set_gate(int vector, uint32_t handler) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = KERNEL_CODE_SELECTOR;
+    idt[vector].zero = 0;
+    idt[vector].type = IDT_INTERRUPT_GATE;
+    idt[vector].offset_high = handler >> 16;
+}
+
+static void pic_set_mask(uint16_t mask) {
+    irq_mask = mask;
+    outb(PIC1_DATA, mask & 0xFF);
+    outb(PIC2_DATA, mask >> 8);
+}
+
+// Move the PICs off the CPU exception vectors (BIOS puts IRQ 0-7 on 8-15)
+static void pic_remap(void) {
+    outb(PIC1_COMMAND, ICW1_INIT);
+    io_wait();
+    outb(PIC2_COMMAND, ICW1_INIT);
+    io_wait();
+    outb(PIC1_DATA, IRQ_BASE);
+    io_wait();
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    io_wait();
+    outb(PIC1_DATA, 4);             // Slave on IRQ2
+    io_wait();
+    outb(PIC2_DATA, 2);             // Slave identity
+    io_wait();
+    outb(PIC1_DATA, ICW4_8086);
+    io_wait();
+    outb(PIC2_DATA, ICW4_8086);
+    io_wait();
+    
+    pic_set_mask(0xFFFF & ~(1 << 2));
+}
+
+static uint16_t pic_read_isr(void) {
+    outb(PIC1_COMMAND, PIC_READ_ISR);
+    outb(PIC2_COMMAND, PIC_READ_ISR);
+    return (inb(PIC2_COMMAND) << 8) | inb(PIC1_COMMAND);
+}
+
+// Raised but not yet delivered (interrupts off, or a higher one in service)
+int irq_pending(int irq) {
+    if (irq < 0 || irq >= IRQ_COUNT) return 0;
+    if (irq < 8) {
+        outb(PIC1_COMMAND, PIC_READ_IRR);
+        return (inb(PIC1_COMMAND) >> irq) & 1;
+    }
+    outb(PIC2_COMMAND, PIC_READ_IRR);
+    return (inb(PIC2_COMMAND) >> (irq - 8)) & 1;
+}
+
+void interrupts_init(void) {
+    uint32_t cr4;
+    
+    interrupts_disable();
+    gdt_load(&boot_descriptors, (uint32_t)stack_top);
+    
+    for (int vector = 0; vector < EXCEPTION_COUNT; vector++) {
+        idt_set_gate(vector, exception_stub_table[vector]);
+    }
+    for (int irq = 0; irq < IRQ_COUNT; irq++) {
+        idt_set_gate(IRQ_BASE + irq, irq_stub_table[irq]);
+    }
+    idt_set_gate(IPI_WAKEUP_VECTOR, (uint32_t)ipi_wakeup_stub);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)apic_spurious_stub);
+    idt_load();
+    
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    interrupt_save_fpu = (cr4 >> 9) & 1;
+    
+    pic_remap();
+}
+
+void interrupts_init_cpu(cpu_descriptors_t* descriptors, uint32_t stack_top_address) {
+    gdt_load(descriptors, stack_top_address);
+    idt_load();
+}
+
+int irq_register(int irq, irq_handler_t handler) {
+    if (irq < 0 || irq >= IRQ_COUNT || irq == 2 || !handler) return 0;
+    if (irq_handlers[irq]) return 0;
+    
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    pic_set_mask(irq_mask & ~(1 << irq));
+    irq_restore(flags);
+    return 1;
+}
+
+void irq_unregister(int irq) {
+    if (irq < 0 || irq >= IRQ_COUNT || irq == 2) return;
+    
+    uint32_t flags = irq_save();
+    pic_set_mask(irq_mask | (1 << irq));
+    irq_handlers[irq] = 0;
+    irq_restore(flags);
+}
+
+void interrupts_enable(void) {
+    __asm__ volatile ("sti" : : : "memory");
+}
+
+void interrupts_disable(void) {
+    __asm__ volatile ("cli" : : : "memory");
+}
+
+int interrupts_enabled(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf\n pop %0" : "=r"(flags));
+    return (flags >> 9) & 1;
+}
+
+uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf\n pop %0\n cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+void irq_restore(uint32_t flags) {
+    if (flags & (1 << 9)) interrupts_enable();
+}
+
+void cpu_idle(void) {
+    if (!interrupts_enabled()) {
+        __asm__ volatile ("pause");
+        return;
+    }
+    // With threads, let the others run until the next interrupt
+    if (thread_wait_interrupt()) return;
+    __asm__ volatile ("hlt" : : : "memory");
+}
+
+// The kernel runs in ring 0 only, so every exception is a kernel bug:
+// report where it happened and stop
+static void exception_panic(interrupt_frame_t* frame) {
+    uint32_t cr2;
+    __asm__ volatile ("mov %%cr2, %0" : "=r"(cr2));
+    
+    kprintf_colored(COLOR_ERROR, BLACK, "\nKernel panic: %s (vector %u, error code 0x%x)\n",
+                    exception_names[frame->vector], frame->vector, frame->error_code);
+    kprintf("EIP=%08x CS=%04x EFLAGS=%08x\n", frame->eip, frame->cs, frame->eflags);
+    kprintf("EAX=%08x EBX=%08x ECX=%08x EDX=%08x\n", frame->eax, frame->ebx, frame->ecx, frame->edx);
+    // A same-privilege trap pushes no ESP, so the interrupted stack starts
+    // right after EFLAGS
+    kprintf("ESI=%08x EDI=%08x EBP=%08x ESP=%08x\n", frame->esi, frame->edi, frame->ebp,
+            (uint32_t)&frame->eflags + 4);
+    if (frame->vector == 14) {
+        kprintf("CR2=%08x (%s, %s)\n", cr2,
+                (frame->error_code & 1) ? "protection violation" : "page not present",
+                (frame->error_code & 2) ? "write" : "read");
+    }
+    kprintf_colored(COLOR_ERROR, BLACK, "System halted.\n");
+    
+    for (;;) {
+        __asm__ volatile ("cli\n hlt");
+    }
+}
+
+void interrupt_dispatch(interrupt_frame_t* frame) {
+    if (frame->vector < EXCEPTION_COUNT) {
+        exception_panic(frame);
+    }
+    if (frame->vector == IPI_WAKEUP_VECTOR) {
+        lapic_eoi();
+        return;
+    }
+    
+    int irq = frame->vector - IRQ_BASE;
+    if (irq < 0 || irq >= IRQ_COUNT) return;
+    
+    // A line that drops before the CPU acknowledges it shows up as IRQ 7
+    // or 15 with no in-service bit; those must not be acknowledged
+    // (except the cascade on the master for IRQ 15)
+    if (irq == 7 && !(pic_read_isr() & (1 << 7))) return;
+    if (irq == 15 && !(pic_read_isr() & (1 << 15))) {
+        outb(PIC1_COMMAND, PIC_EOI);
+        return;
+    }
+    
+    if (irq_handlers[irq]) irq_handlers[irq](frame);
+    
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+    
+    // May switch threads; this one resumes here later
+    thread_irq_exit();
+}
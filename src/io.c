@@ -1,4 +1,5 @@
 #include "io.h"
+#include "timer.h"
 
 void outb(unsigned short port, unsigned char data) {
     __asm__ volatile ("outb %0, %1" : : "a"(data), "Nd"(port));
@@ -30,6 +31,22 @@ unsigned int inl(unsigned short port) {
     return result;
 }
 
+// Port 0x80 is the POST code port; writing it takes about a microsecond
+void io_wait(void) {
+    outb(0x80, 0);
+}
+
+unsigned long long rdmsr(unsigned int msr) {
+    unsigned int low, high;
+    __asm__ volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((unsigned long long)high << 32) | low;
+}
+
+void wrmsr(unsigned int msr, unsigned long long value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((unsigned int)value), "d"((unsigned int)(value >> 32)));
+}
+
+// Short pause for messages to be seen (shutdown)
 void delay() {
-    for (volatile int i = 0; i < 1000000; i++);
-}
\ No newline at end of file
+    ksleep_ms(DELAY_MS);
+}
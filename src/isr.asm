@@ -0,0 +1,191 @@
+; مداخل الاستثناءات والمقاطعات: كل مدخل يدفع رقم المتجه ثم يقفز إلى interrupt_common
+[bits 32]
+
+section .text
+extern interrupt_dispatch
+extern interrupt_save_fpu
+
+; CPU exceptions. Vectors 8, 10-14, 17, 21, 29 and 30 come with an error
+; code pushed by the CPU; the others get a zero in its place.
+%macro EXCEPTION_STUB 1
+exception_stub_%1:
+    push dword 0
+    push dword %1
+    jmp interrupt_common
+%endmacro
+
+%macro EXCEPTION_STUB_ERRCODE 1
+exception_stub_%1:
+    push dword %1
+    jmp interrupt_common
+%endmacro
+
+EXCEPTION_STUB 0
+EXCEPTION_STUB 1
+EXCEPTION_STUB 2
+EXCEPTION_STUB 3
+EXCEPTION_STUB 4
+EXCEPTION_STUB 5
+EXCEPTION_STUB 6
+EXCEPTION_STUB 7
+EXCEPTION_STUB_ERRCODE 8
+EXCEPTION_STUB 9
+EXCEPTION_STUB_ERRCODE 10
+EXCEPTION_STUB_ERRCODE 11
+EXCEPTION_STUB_ERRCODE 12
+EXCEPTION_STUB_ERRCODE 13
+EXCEPTION_STUB_ERRCODE 14
+EXCEPTION_STUB 15
+EXCEPTION_STUB 16
+EXCEPTION_STUB_ERRCODE 17
+EXCEPTION_STUB 18
+EXCEPTION_STUB 19
+EXCEPTION_STUB 20
+EXCEPTION_STUB_ERRCODE 21
+EXCEPTION_STUB 22
+EXCEPTION_STUB 23
+EXCEPTION_STUB 24
+EXCEPTION_STUB 25
+EXCEPTION_STUB 26
+EXCEPTION_STUB 27
+EXCEPTION_STUB 28
+EXCEPTION_STUB_ERRCODE 29
+EXCEPTION_STUB_ERRCODE 30
+EXCEPTION_STUB 31
+
+; IRQ stubs: no CPU error code, so push a zero to keep one frame layout
+%macro IRQ_STUB 1
+irq_stub_%1:
+    push dword 0
+    push dword 32 + %1
+    jmp interrupt_common
+%endmacro
+
+IRQ_STUB 0
+IRQ_STUB 1
+IRQ_STUB 2
+IRQ_STUB 3
+IRQ_STUB 4
+IRQ_STUB 5
+IRQ_STUB 6
+IRQ_STUB 7
+IRQ_STUB 8
+IRQ_STUB 9
+IRQ_STUB 10
+IRQ_STUB 11
+IRQ_STUB 12
+IRQ_STUB 13
+IRQ_STUB 14
+IRQ_STUB 15
+
+; Local APIC vectors. The wakeup IPI goes through the common path so it
+; can be acknowledged; a spurious APIC interrupt must not be.
+global ipi_wakeup_stub
+ipi_wakeup_stub:
+    push dword 0
+    push dword 0xF0
+    jmp interrupt_common
+
+global apic_spurious_stub
+apic_spurious_stub:
+    iretd
+
+; Save the interrupted state as an interrupt_frame_t and call
+; interrupt_dispatch(frame). The SSE registers are saved too once the
+; kernel has enabled them, since handlers may call the SSE string routines.
+interrupt_common:
+    pusha
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    cld
+
+    mov ebx, esp                ; ebx = frame, preserved across the call
+    and esp, 0xFFFFFFF0         ; fxsave and the C code want 16-byte alignment
+    cmp dword [interrupt_save_fpu], 0
+    je .no_save
+    sub esp, 512
+    fxsave [esp]
+.no_save:
+    sub esp, 12
+    push ebx
+    call interrupt_dispatch
+    add esp, 16
+
+    cmp dword [interrupt_save_fpu], 0
+    je .no_restore
+    fxrstor [esp]
+.no_restore:
+    mov esp, ebx
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    popa
+    add esp, 8                  ; vector and error code
+    iretd
+
+section .data
+global exception_stub_table
+exception_stub_table:
+    dd exception_stub_0
+    dd exception_stub_1
+    dd exception_stub_2
+    dd exception_stub_3
+    dd exception_stub_4
+    dd exception_stub_5
+    dd exception_stub_6
+    dd exception_stub_7
+    dd exception_stub_8
+    dd exception_stub_9
+    dd exception_stub_10
+    dd exception_stub_11
+    dd exception_stub_12
+    dd exception_stub_13
+    dd exception_stub_14
+    dd exception_stub_15
+    dd exception_stub_16
+    dd exception_stub_17
+    dd exception_stub_18
+    dd exception_stub_19
+    dd exception_stub_20
+    dd exception_stub_21
+    dd exception_stub_22
+    dd exception_stub_23
+    dd exception_stub_24
+    dd exception_stub_25
+    dd exception_stub_26
+    dd exception_stub_27
+    dd exception_stub_28
+    dd exception_stub_29
+    dd exception_stub_30
+    dd exception_stub_31
+
+global irq_stub_table
+irq_stub_table:
+    dd irq_stub_0
+    dd irq_stub_1
+    dd irq_stub_2
+    dd irq_stub_3
+    dd irq_stub_4
+    dd irq_stub_5
+    dd irq_stub_6
+    dd irq_stub_7
+    dd irq_stub_8
+    dd irq_stub_9
+    dd irq_stub_10
+    dd irq_stub_11
+    dd irq_stub_12
+    dd irq_stub_13
+    dd irq_stub_14
+    dd irq_stub_15
+
+; إضافة .note.GNU-stack section لحل التحذير
+section .note.GNU-stack noalloc noexec nowrite progbits
@@ -0,0 +1,260 @@
+#include "jobs.h"
+#include "command_handler.h"
+#include "thread.h"
+#include "arena.h"
+#include "memory.h"
+#include "display.h"
+#include "kprintf.h"
+#include "string_utils.h"
+
+#define JOB_POLL_MS 10                  // How often `wait` checks a job
+
+typedef struct {
+    int number;                         // 0: slot free
+    uint32_t thread_id;
+    thread_t* thread;                   // Set by the job itself; valid until done
+    char command[JOB_COMMAND_LENGTH];
+    char* output;                       // JOB_OUTPUT_SIZE bytes
+    size_t length;                      // Bytes in `output`
+    size_t shown;                       // ... of which already printed
+    int dropped;                        // Output lost to a full buffer
+    int foreground;                     // Output goes straight to the screen
+    int stop_reported;                  // Told the user it waits for input
+    int shown_fg;                       // Colours in effect where `shown`
+    int shown_bg;                       // ... ends
+    volatile int done;
+    arena_t scratch;
+} job_t;
+
+static job_t jobs[JOB_MAX];
+static int last_started = 0;            // Default job for fg
+
+// Sink of a job's thread. The console calls it with preemption off, so
+// the shell never reads a half-appended buffer.
+static int job_output(void* data, const char* text, size_t length) {
+    job_t* job = (job_t*)data;
+    if (job->foreground) return 0;
+    
+    size_t room = JOB_OUTPUT_SIZE - job->length;
+    if (length > room) {
+        job->dropped = 1;
+        length = room;
+    }
+    memcpy(job->output + job->length, text, length);
+    job->length += length;
+    return 1;
+}
+
+// Job control from inside a job would wait on itself
+static int in_job(void) {
+    thread_t* self = thread_current();
+    if (self && self->output == job_output) {
+        shell_print_colored("Job control is not available in a background job\n", COLOR_ERROR, BLACK);
+        return 1;
+    }
+    return 0;
+}
+
+static void job_main(void* arg) {
+    job_t* job = (job_t*)arg;
+    job->thread = thread_current();
+    thread_set_output(job_output, job);
+    thread_set_scratch(&job->scratch);
+    set_color(WHITE, BLACK);            // Lands in the output, not the shell's
+    
+    // process_command() tokenizes the line in place
+    char line[JOB_COMMAND_LENGTH];
+    SAFE_STRCPY(line, job->command, sizeof(line));
+    if (!process_command(line)) {
+        kprintf_colored(COLOR_ERROR, BLACK, "Unknown command: %s\n", job->command);
+    }
+    job->done = 1;
+}
+
+// Job `number`; 0 means the last one started, or failing that the newest
+static job_t* find_job(int number) {
+    if (number == 0 && !last_started) {
+        for (int i = JOB_MAX - 1; i >= 0; i--) {
+            if (jobs[i].number) return &jobs[i];
+        }
+        return NULL;
+    }
+    if (number == 0) number = last_started;
+    for (int i = 0; i < JOB_MAX; i++) {
+        if (jobs[i].number && jobs[i].number == number) return &jobs[i];
+    }
+    return NULL;
+}
+
+// Blocked in get_char() until it is brought to the foreground. A thread
+// is only freed after `done` is set, and it cannot exit meanwhile with
+// preemption off.
+static int job_stopped(job_t* job) {
+    preempt_disable();
+    int stopped = !job->done && job->thread && job->thread->input_blocked;
+    preempt_enable();
+    return stopped;
+}
+
+static void report_stopped(job_t* job) {
+    kprintf_colored(COLOR_WARNING, BLACK, "[%d] Stopped (waiting for input)  %s - use 'fg %%%d'\n",
+                    job->number, job->command, job->number);
+    job->stop_reported = 1;
+}
+
+// Wait until the job finishes; 0 if it stops for input instead, which
+// only `fg` can resolve
+static int wait_done(job_t* job) {
+    while (!job->done) {
+        if (job_stopped(job)) return 0;
+        thread_sleep_ms(JOB_POLL_MS);
+    }
+    return 1;
+}
+
+// Print what the job wrote since last time. Its colours are SGR
+// sequences in the output; the shell gets its own back afterwards.
+static void show_output(job_t* job) {
+    preempt_disable();
+    if (job->length > job->shown) {
+        int shell_fg = current_fg_color;
+        int shell_bg = current_bg_color;
+        set_color(job->shown_fg, job->shown_bg);
+        shell_print_buffer(job->output + job->shown, job->length - job->shown);
+        job->shown = job->length;
+        job->shown_fg = current_fg_color;
+        job->shown_bg = current_bg_color;
+        set_color(shell_fg, shell_bg);
+    }
+    preempt_enable();
+}
+
+// Wait for the job's thread, show the rest of its output and free it
+static void finish_job(job_t* job, int report) {
+    thread_join(job->thread_id);
+    show_output(job);
+    if (job->dropped) {
+        kprintf_colored(COLOR_WARNING, BLACK, "[%d] Output truncated to %u bytes\n", job->number, JOB_OUTPUT_SIZE);
+    }
+    if (report) {
+        kprintf_colored(COLOR_INFO, BLACK, "[%d] Done    %s\n", job->number, job->command);
+    }
+    
+    free(job->output);
+    arena_destroy(&job->scratch);
+    if (last_started == job->number) last_started = 0;
+    job->number = 0;
+}
+
+int job_start(const char* command) {
+    if (in_job()) return -1;
+    if (!thread_scheduler_running()) {
+        shell_print_colored("Background jobs need the scheduler\n", COLOR_ERROR, BLACK);
+        return -1;
+    }
+    
+    job_t* job = NULL;
+    for (int i = 0; i < JOB_MAX && !job; i++) {
+        if (!jobs[i].number) job = &jobs[i];
+    }
+    if (!job) {
+        kprintf_colored(COLOR_ERROR, BLACK, "Too many jobs (at most %d)\n", JOB_MAX);
+        return -1;
+    }
+    
+    char* output = (char*)malloc(JOB_OUTPUT_SIZE);
+    if (!output) {
+        shell_print_colored("Out of memory for the job\n", COLOR_ERROR, BLACK);
+        return -1;
+    }
+    
+    memset(job, 0, sizeof(job_t));
+    job->number = (int)(job - jobs) + 1;
+    job->output = output;
+    job->shown_fg = WHITE;
+    job->shown_bg = BLACK;
+    SAFE_STRCPY(job->command, command, sizeof(job->command));
+    arena_init(&job->scratch, ARENA_CHUNK_SIZE);
+    
+    // Low priority: the shell preempts the job as soon as a key arrives
+    job->thread_id = thread_create(job->command, job_main, job, THREAD_PRIORITY_LOW);
+    if (!job->thread_id) {
+        free(output);
+        job->number = 0;
+        shell_print_colored("Could not start a thread for the job\n", COLOR_ERROR, BLACK);
+        return -1;
+    }
+    
+    last_started = job->number;
+    kprintf("[%d] %u\n", job->number, job->thread_id);
+    return job->number;
+}
+
+void jobs_list(void) {
+    if (in_job()) return;
+    
+    int count = 0;
+    for (int i = 0; i < JOB_MAX; i++) {
+        job_t* job = &jobs[i];
+        if (!job->number) continue;
+        const char* state = job->done ? "Done" : job_stopped(job) ? "Stopped" : "Running";
+        kprintf("[%d]%c %-8s %s (%u bytes of output)\n", job->number,
+                job->number == last_started ? '+' : ' ',
+                state, job->command, (unsigned int)job->length);
+        count++;
+    }
+    if (!count) shell_print_string("No jobs\n");
+}
+
+int job_foreground(int number) {
+    if (in_job()) return 0;
+    job_t* job = find_job(number);
+    if (!job) return -1;
+    
+    kprintf("%s\n", job->command);
+    preempt_disable();
+    show_output(job);
+    job->foreground = 1;
+    preempt_enable();
+    
+    // A job stopped in get_char() may read the keyboard now
+    thread_console_changed();
+    finish_job(job, 0);
+    return 0;
+}
+
+int job_wait(int number) {
+    if (in_job()) return 0;
+    if (number) {
+        job_t* job = find_job(number);
+        if (!job) return -1;
+        if (wait_done(job)) {
+            finish_job(job, 1);
+        } else {
+            report_stopped(job);
+        }
+        return 0;
+    }
+    
+    for (int i = 0; i < JOB_MAX; i++) {
+        if (!jobs[i].number) continue;
+        if (wait_done(&jobs[i])) {
+            finish_job(&jobs[i], 1);
+        } else {
+            report_stopped(&jobs[i]);
+        }
+    }
+    return 0;
+}
+
+void jobs_notify(void) {
+    for (int i = 0; i < JOB_MAX; i++) {
+        job_t* job = &jobs[i];
+        if (!job->number) continue;
+        if (job->done) {
+            finish_job(job, 1);
+        } else if (!job->stop_reported && job_stopped(job)) {
+            report_stopped(job);
+        }
+    }
+}
@@ -4,20 +4,24 @@
 #include "keyboard.h"
 #include "filesystem.h"
 #include "memory.h"
+#include "pmm.h"
+#include "paging.h"
+#include "multiboot.h"
+#include "hardware_detection.h"
+#include "kprintf.h"
+#include "interrupts.h"
+#include "serial.h"
+#include "timer.h"
+#include "tsc.h"
+#include "smp.h"
+#include "thread.h"
+#include "jobs.h"
 
 #include "shell.h"
 #include "command_handler.h"
 // Global variables for kernel
 // Display variables moved to display.c
 // Editor variables moved to editor.c
-#define PIT_FREQ 100
-volatile unsigned int system_ticks = 0;
-extern void irq0_handler();
-
-// Timer interrupt handler
-void timer_handler() {
-    system_ticks++;
-}
 void shell_print_string(const char* str);
 // Help function declarations moved to shell.h
 // Display and I/O functions are now in separate modules
@@ -31,15 +35,20 @@ void readline(char* buffer, int max_len);
 int find_matching_commands(const char* prefix, char matches[][128], int max_matches);
 int find_matching_files(const char* prefix, char matches[][128], int max_matches, int only_files);
 // Editor function declarations moved to editor.h
-void kernel_main();
+void kernel_main(multiboot_info_t* mbi);
 /* الدالة الرئيسية للنواة */
-int main() {
+int main(uint32_t magic, multiboot_info_t* mbi) {
+    // Only trust the boot information if a Multiboot loader passed it
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        mbi = NULL;
+    }
+    
     // Call kernel_main to start the system
-    kernel_main();
+    kernel_main(mbi);
     return 0;
 }
 
-void kernel_main() {
+void kernel_main(multiboot_info_t* mbi) {
     // Clear screen using display functions
     clear_screen();
     
@@ -56,6 +65,27 @@ void kernel_main() {
     shell_print_colored("                 Advanced Operating System\n\n", COLOR_WARNING, BLACK);
     
     // Initialize systems
+    shell_print_colored("[INFO] Selecting memory/string routines: ", COLOR_INFO, BLACK);
+    string_select_variants(cpu_enable_sse(), cpu_has_erms());
+    shell_print_colored(string_variant_name(), COLOR_INFO, BLACK);
+    shell_print_colored("\n", COLOR_INFO, BLACK);
+    
+    shell_print_colored("[INFO] Setting up interrupts...\n", COLOR_INFO, BLACK);
+    interrupts_init();
+    if (!timer_init(TIMER_DEFAULT_HZ)) {
+        shell_print_colored("[WARNING] Could not install the timer interrupt\n", COLOR_WARNING, BLACK);
+    }
+    if (tsc_init()) {
+        uint32_t khz = (uint32_t)(tsc_frequency() / 1000);
+        kprintf_colored(COLOR_INFO, BLACK, "[INFO] TSC clocksource at %u.%03u MHz\n", khz / 1000, khz % 1000);
+    } else {
+        shell_print_colored("[WARNING] No usable TSC, timing falls back to the PIT tick\n", COLOR_WARNING, BLACK);
+    }
+    if (serial_init()) {
+        shell_print_colored("[INFO] Serial console on COM1 (115200 8N1)\n", COLOR_INFO, BLACK);
+    }
+    interrupts_enable();
+    
     shell_print_colored("[INFO] Initializing keyboard...\n", COLOR_INFO, BLACK);
     init_keyboard();
     
@@ -64,6 +94,32 @@ void kernel_main() {
     
     shell_print_colored("[INFO] Initializing memory management...\n", COLOR_INFO, BLACK);
     memory_init();
+    pmm_init(mbi);
+    if (pmm_get_total_memory() > 0) {
+        // Let the heap grow into physical memory beyond the static pool
+        memory_set_grow_handler(pmm_heap_grow);
+    } else {
+        shell_print_colored("[WARNING] No memory map from boot loader, heap limited to 1MB\n", COLOR_WARNING, BLACK);
+    }
+    
+    shell_print_colored("[INFO] Enabling paging...\n", COLOR_INFO, BLACK);
+    paging_init();
+    
+    // The framebuffer is mapped write-combining, so switch after paging is on
+    if (display_init_framebuffer(mbi)) {
+        kprintf_colored(COLOR_INFO, BLACK, "[INFO] Framebuffer console: %dx%d text\n", display_columns(), display_rows());
+    }
+    
+    shell_print_colored("[INFO] Starting application processors...\n", COLOR_INFO, BLACK);
+    kprintf_colored(COLOR_INFO, BLACK, "[INFO] %d CPU(s) online\n", smp_init());
+    
+    // From here on the shell is the first kernel thread
+    thread_init("shell");
+    if (thread_scheduler_running()) {
+        shell_print_colored("[INFO] Scheduler started\n", COLOR_INFO, BLACK);
+    } else {
+        shell_print_colored("[ERROR] Could not start the scheduler\n", COLOR_ERROR, BLACK);
+    }
     
     shell_print_colored("[SUCCESS] System initialization complete!\n", COLOR_SUCCESS, BLACK);
     shell_print_colored("[INFO] Type 'help' for available commands.\n\n", COLOR_INFO, BLACK);
@@ -71,14 +127,13 @@ void kernel_main() {
     // Main shell loop
     char cmd_buffer[256];
     while (1) {
+        // Report background jobs that finished since the last prompt
+        jobs_notify();
+        
         // Show prompt
         char current_path[256];
         get_current_path(current_path);
-        shell_print_colored("oszoOS", COLOR_SUCCESS, BLACK);
-        shell_print_colored(" ", WHITE, BLACK);
-        shell_print_colored(current_path, COLOR_DIR, BLACK);
-        shell_print_colored(" > ", COLOR_WARNING, BLACK);
-        set_color(WHITE, BLACK);
+        shell_print_prompt(current_path);
         
         // Read command
         readline(cmd_buffer, sizeof(cmd_buffer));
@@ -125,7 +180,12 @@ void process_cmd(char* cmd) {
         strcmp(command, "run") == 0 ||
         strcmp(command, "shutdown") == 0 ||
         strcmp(command, "fat32") == 0 ||
-        strcmp(command, "debug") == 0) {
+        strcmp(command, "debug") == 0 ||
+        strcmp(command, "time") == 0 ||
+        strcmp(command, "ps") == 0 ||
+        strcmp(command, "jobs") == 0 ||
+        strcmp(command, "fg") == 0 ||
+        strcmp(command, "wait") == 0) {
         return; // Already handled by new system
     }
     
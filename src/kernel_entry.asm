@@ -6,13 +6,17 @@ section .multiboot
 align 4
 multiboot_header:
     dd 0x1BADB002            ; magic number (required)
-    dd 0x00000003            ; flags: page align modules and provide memory map
-    dd -(0x1BADB002 + 0x00000003)  ; checksum (magic + flags + checksum = 0)
+    dd 0x00000007            ; flags: page align modules, provide memory map, request video mode
+    dd -(0x1BADB002 + 0x00000007)  ; checksum (magic + flags + checksum = 0)
+    dd 0, 0, 0, 0, 0         ; address fields (unused, flag 16 is clear)
+    dd 0                     ; mode_type: linear framebuffer
+    dd 1024                  ; width
+    dd 768                   ; height
+    dd 32                    ; depth
 
 section .text
 global _start
 extern main
-extern timer_handler
 
 _start:
     ; إعداد المكدس
@@ -21,21 +25,21 @@ _start:
     ; تأكد من أن المكدس محاذي على 16 بايت
     and esp, 0xFFFFFFF0
     
+    ; تمرير معلومات Multiboot: main(magic, mbi)
+    sub esp, 8
+    push ebx                 ; عنوان بنية multiboot_info
+    push eax                 ; الرقم السحري من GRUB
+    
     ; استدعاء دالة main في النواة
     call main
     
-    ; حلقة لا نهائية
-    jmp $
-
-; Timer interrupt handler (IRQ0)
-global irq0_handler
-irq0_handler:
-    pusha
-    call timer_handler
-    popa
-    iretd
+    ; حلقة لا نهائية: إيقاف المعالج حتى المقاطعة التالية بدلاً من الدوران
+.hang:
+    hlt
+    jmp .hang
 
 section .bss
+global stack_top
 stack_bottom:
     resb 16384 ; 16 KiB
 stack_top:
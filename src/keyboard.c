@@ -12,14 +12,26 @@
 
 #include "keyboard.h"
 #include "io.h"
+#include "display.h"
+#include "serial.h"
+#include "interrupts.h"
+#include "thread.h"
 
 
 // Global keyboard state variables
-unsigned char kbd_flags = 0;
+unsigned short kbd_flags = 0;
 unsigned char kbd_leds = 2; // num-lock on by default
 unsigned char extended_key = 0;
 unsigned char e1_prefix = 0;
 
+// Scancodes arrive on IRQ 1 and wait here for read_key(). The handler only
+// advances scancode_tail and read_key() only advances scancode_head, so the
+// ring needs no lock. Indices run freely and are masked on access.
+static volatile unsigned char scancode_ring[SCANCODE_RING_SIZE];
+static volatile unsigned int scancode_head = 0;
+static volatile unsigned int scancode_tail = 0;
+static int keyboard_irq_enabled = 0;
+
 // US keyboard layout (normal)
 unsigned char kbd_us[128] = {
     // 0x00-0x0F: Special keys and numbers
@@ -64,9 +76,13 @@ unsigned char kbd_us_shift[128] = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-// Wait for keyboard controller to be ready
+// Wait for keyboard controller to be ready. The input buffer drains within
+// microseconds and raises no interrupt, so this spins rather than halts,
+// and gives up if the controller never answers.
 void kbd_wait(void) {
-    while (inb(KEYBOARD_STATUS_PORT) & 0x02);
+    for (int i = 0; i < KBD_WAIT_LIMIT && (inb(KEYBOARD_STATUS_PORT) & 0x02); i++) {
+        __asm__ volatile ("pause");
+    }
 }
 
 // Alternative wait function (compatibility)
@@ -95,19 +111,19 @@ void handle_modifier_key(unsigned char scancode, unsigned char pressed) {
             break;
         case KEY_LCTRL:
             if (pressed) {
-                if (extended_key) kbd_flags |= (KEY_CTRL << 1);
+                if (extended_key) kbd_flags |= KEY_RCTRL;
                 else kbd_flags |= KEY_CTRL;
             } else {
-                if (extended_key) kbd_flags &= ~(KEY_CTRL << 1);
+                if (extended_key) kbd_flags &= ~KEY_RCTRL;
                 else kbd_flags &= ~KEY_CTRL;
             }
             break;
         case KEY_LALT:
             if (pressed) {
-                if (extended_key) kbd_flags |= (KEY_ALT << 1);
+                if (extended_key) kbd_flags |= KEY_RALT;
                 else kbd_flags |= KEY_ALT;
             } else {
-                if (extended_key) kbd_flags &= ~(KEY_ALT << 1);
+                if (extended_key) kbd_flags &= ~KEY_RALT;
                 else kbd_flags &= ~KEY_ALT;
             }
             break;
@@ -180,26 +196,60 @@ char handle_function_keys(unsigned char scancode) {
     return 0;
 }
 
+static void keyboard_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    keyboard_interrupt();
+}
+
 // Initialize keyboard
 void init_keyboard(void) {
     kbd_flags = 0;
     extended_key = 0;
     e1_prefix = 0;
     kbd_leds = 2; // Num lock on
+    
+    // Drop anything left in the controller from before we took over
+    while (inb(KEYBOARD_STATUS_PORT) & 0x01) inb(KEYBOARD_DATA_PORT);
+    keyboard_irq_enabled = irq_register(KEYBOARD_IRQ, keyboard_irq);
+    
     set_leds();
 }
 
-// Get character from keyboard
-int get_char(void) {
+// Next raw scancode, or -1 if none is waiting. Without the interrupt the
+// controller is polled directly.
+static int next_scancode(void) {
+    if (scancode_head != scancode_tail) {
+        unsigned char scancode = scancode_ring[scancode_head & (SCANCODE_RING_SIZE - 1)];
+        __asm__ volatile ("" : : : "memory");
+        scancode_head++;
+        return scancode;
+    }
+    if (!keyboard_irq_enabled && (inb(KEYBOARD_STATUS_PORT) & 0x01)) {
+        return inb(KEYBOARD_DATA_PORT);
+    }
+    return -1;
+}
+
+// Read one key from the keyboard or the serial line, handling scrollback
+// keys internally
+static int read_key(void) {
     unsigned char scancode;
     unsigned char pressed;
     char ch;
     
     while (1) {
         // Wait for key press
-        while (!(inb(KEYBOARD_STATUS_PORT) & 0x01));
+        int next;
+        while ((next = next_scancode()) < 0) {
+            int key = serial_read_key();
+            if (key >= 0) return key;
+            cpu_idle();
+        }
         
-        scancode = inb(KEYBOARD_DATA_PORT);
+        scancode = next;
+        
+        // Controller replies to the LED command
+        if (scancode == 0xFA || scancode == 0xFE) continue;
         
         // Handle extended key prefixes
         if (scancode == 0xE0) {
@@ -216,6 +266,13 @@ int get_char(void) {
         pressed = !(scancode & KEY_RELEASE);
         scancode &= 0x7F; // Remove release bit
         
+        // E0 2A / E0 AA are fake shifts sent around the grey keys; they must
+        // not change the real shift state
+        if (extended_key && (scancode == KEY_LSHIFT_SC || scancode == KEY_RSHIFT_SC)) {
+            extended_key = 0;
+            continue;
+        }
+        
         // Handle modifier keys
         if (scancode == KEY_LSHIFT_SC || scancode == KEY_RSHIFT_SC ||
             scancode == KEY_LCTRL || scancode == KEY_LALT ||
@@ -232,6 +289,22 @@ int get_char(void) {
             continue;
         }
         
+        // Shift+PgUp/PgDn browse the console scrollback
+        if ((scancode == KEY_PAGE_UP || scancode == KEY_PAGE_DOWN) &&
+            (kbd_flags & (KEY_LSHIFT | KEY_RSHIFT))) {
+            display_scroll_view(scancode == KEY_PAGE_UP ? SCROLLBACK_STEP : -SCROLLBACK_STEP);
+            extended_key = 0;
+            continue;
+        }
+        
+        // Alt+F1..F4 switch virtual terminals
+        if (scancode >= KEY_F1 && scancode < KEY_F1 + VT_COUNT &&
+            (kbd_flags & (KEY_ALT | KEY_RALT))) {
+            display_switch_vt(scancode - KEY_F1);
+            extended_key = 0;
+            return KEY_VT_SWITCH;
+        }
+        
         // Handle cursor/numeric keypad
         if (scancode >= 0x47 && scancode <= 0x53) {
             ch = handle_cursor_keys(scancode);
@@ -280,8 +353,25 @@ int get_char(void) {
     }
 }
 
-// Keyboard interrupt handler (placeholder)
+// Get character from keyboard. Any key that produces input returns a
+// scrolled-back console to the live screen. The scancode ring has a single
+// reader, so a background job waits here until it is in the foreground.
+int get_char(void) {
+    thread_wait_console();
+    int ch = read_key();
+    display_view_live();
+    return ch;
+}
+
+// IRQ 1: move every byte the controller holds into the scancode ring. If
+// the ring is full the byte is dropped.
 void keyboard_interrupt(void) {
-    // This would be called by the interrupt handler
-    // For now, we use polling in get_char()
+    while (inb(KEYBOARD_STATUS_PORT) & 0x01) {
+        unsigned char scancode = inb(KEYBOARD_DATA_PORT);
+        if (scancode_tail - scancode_head < SCANCODE_RING_SIZE) {
+            scancode_ring[scancode_tail & (SCANCODE_RING_SIZE - 1)] = scancode;
+            __asm__ volatile ("" : : : "memory");
+            scancode_tail++;
+        }
+    }
 }
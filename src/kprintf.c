@@ -0,0 +1,286 @@
+#include "kprintf.h"
+#include "display.h"
+#include "string_utils.h"
+
+// Two ASCII digits for every value 0-99, so integers convert two digits
+// per division
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+// Bounded output cursor; counts everything, stores what fits
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t length;
+} kout_t;
+
+static inline void out_char(kout_t* out, char c) {
+    if (out->length + 1 < out->size) {
+        out->buffer[out->length] = c;
+    }
+    out->length++;
+}
+
+static void out_repeat(kout_t* out, char c, int count) {
+    while (count-- > 0) out_char(out, c);
+}
+
+static void out_chars(kout_t* out, const char* s, size_t n) {
+    if (out->length + 1 < out->size) {
+        size_t room = out->size - 1 - out->length;
+        memcpy(out->buffer + out->length, s, n < room ? n : room);
+    }
+    out->length += n;
+}
+
+// Write `value` right-aligned, ending just before `end`; returns its start
+static char* format_u32(uint32_t value, char* end) {
+    while (value >= 100) {
+        uint32_t pair = value % 100;
+        value /= 100;
+        end -= 2;
+        end[0] = digit_pairs[pair * 2];
+        end[1] = digit_pairs[pair * 2 + 1];
+    }
+    if (value >= 10) {
+        end -= 2;
+        end[0] = digit_pairs[value * 2];
+        end[1] = digit_pairs[value * 2 + 1];
+    } else {
+        *--end = '0' + value;
+    }
+    return end;
+}
+
+static char* format_u64(uint64_t value, char* end) {
+    // One 64-bit division per 8 digits, then 32-bit arithmetic
+    while (value > 0xFFFFFFFFULL) {
+        uint64_t high = value / 100000000;
+        uint32_t low = (uint32_t)(value - high * 100000000);
+        value = high;
+        
+        for (int i = 0; i < 4; i++) {
+            uint32_t pair = low % 100;
+            low /= 100;
+            end -= 2;
+            end[0] = digit_pairs[pair * 2];
+            end[1] = digit_pairs[pair * 2 + 1];
+        }
+    }
+    return format_u32((uint32_t)value, end);
+}
+
+static char* format_hex(uint64_t value, char* end, const char* digits) {
+    do {
+        *--end = digits[value & 0xF];
+        value >>= 4;
+    } while (value);
+    return end;
+}
+
+// Emit `body` (with optional sign) padded to `width`
+static void out_padded(kout_t* out, const char* sign, const char* body, size_t length,
+                       int width, int left, int zero) {
+    size_t sign_length = sign ? 1 : 0;
+    int pad = width - (int)(length + sign_length);
+    
+    if (!left && !zero) out_repeat(out, ' ', pad);
+    if (sign) out_char(out, *sign);
+    if (!left && zero) out_repeat(out, '0', pad);
+    out_chars(out, body, length);
+    if (left) out_repeat(out, ' ', pad);
+}
+
+int kvsnprintf(char* buffer, size_t size, const char* format, va_list args) {
+    kout_t out = {buffer, size, 0};
+    char digits[24];
+    char* digits_end = digits + sizeof(digits);
+    
+    while (*format) {
+        // Copy literal runs in one go
+        const char* literal = format;
+        while (*format && *format != '%') format++;
+        if (format != literal) out_chars(&out, literal, format - literal);
+        if (!*format) break;
+        format++;
+        
+        int left = 0;
+        int zero = 0;
+        for (;; format++) {
+            if (*format == '-') left = 1;
+            else if (*format == '0') zero = 1;
+            else break;
+        }
+        
+        int width = 0;
+        if (*format == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                left = 1;
+                width = -width;
+            }
+            format++;
+        } else {
+            while (*format >= '0' && *format <= '9') {
+                width = width * 10 + (*format++ - '0');
+            }
+        }
+        
+        int precision = -1;
+        if (*format == '.') {
+            format++;
+            precision = 0;
+            if (*format == '*') {
+                precision = va_arg(args, int);
+                format++;
+            } else {
+                while (*format >= '0' && *format <= '9') {
+                    precision = precision * 10 + (*format++ - '0');
+                }
+            }
+        }
+        
+        int longs = 0;
+        while (*format == 'l') {
+            longs++;
+            format++;
+        }
+        if (*format == 'z') {
+            longs = sizeof(size_t) > sizeof(int) ? 2 : 0;
+            format++;
+        }
+        
+        if (left) zero = 0;
+        char conversion = *format;
+        if (!conversion) break;
+        format++;
+        
+        switch (conversion) {
+            case 'd':
+            case 'i': {
+                int64_t value;
+                if (longs >= 2) value = va_arg(args, long long);
+                else if (longs == 1) value = va_arg(args, long);
+                else value = va_arg(args, int);
+                
+                uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+                char* start = format_u64(magnitude, digits_end);
+                out_padded(&out, value < 0 ? "-" : NULL, start, digits_end - start, width, left, zero);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X': {
+                uint64_t value;
+                if (longs >= 2) value = va_arg(args, unsigned long long);
+                else if (longs == 1) value = va_arg(args, unsigned long);
+                else value = va_arg(args, unsigned int);
+                
+                char* start;
+                if (conversion == 'u') {
+                    start = format_u64(value, digits_end);
+                } else {
+                    start = format_hex(value, digits_end, conversion == 'x' ? hex_lower : hex_upper);
+                }
+                out_padded(&out, NULL, start, digits_end - start, width, left, zero);
+                break;
+            }
+            case 'p': {
+                char* start = format_hex((uintptr_t)va_arg(args, void*), digits_end, hex_lower);
+                while (digits_end - start < 8) *--start = '0';
+                *--start = 'x';
+                *--start = '0';
+                out_padded(&out, NULL, start, digits_end - start, width, left, 0);
+                break;
+            }
+            case 'c': {
+                char c = (char)va_arg(args, int);
+                out_padded(&out, NULL, &c, 1, width, left, 0);
+                break;
+            }
+            case 's': {
+                const char* s = va_arg(args, const char*);
+                if (!s) s = "(null)";
+                size_t length = 0;
+                if (precision >= 0) {
+                    while (length < (size_t)precision && s[length]) length++;
+                } else {
+                    length = strlen(s);
+                }
+                out_padded(&out, NULL, s, length, width, left, 0);
+                break;
+            }
+            case '%':
+                out_char(&out, '%');
+                break;
+            default:
+                // Unknown conversion: print it verbatim
+                out_char(&out, '%');
+                out_char(&out, conversion);
+                break;
+        }
+    }
+    
+    if (size > 0) {
+        buffer[out.length < size ? out.length : size - 1] = '\0';
+    }
+    return (int)out.length;
+}
+
+int ksnprintf(char* buffer, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = kvsnprintf(buffer, size, format, args);
+    va_end(args);
+    return length;
+}
+
+int kprintf(const char* format, ...) {
+    char buffer[KPRINTF_BUFFER_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = kvsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    
+    shell_print_string(buffer);
+    return length;
+}
+
+int kprintf_colored(int fg, int bg, const char* format, ...) {
+    char buffer[KPRINTF_BUFFER_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = kvsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    
+    shell_print_colored(buffer, fg, bg);
+    return length;
+}
+
+char* kformat_size(uint64_t bytes, char* buffer, size_t size) {
+    static const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit = 0;
+    
+    while (unit < 4 && bytes >= (1024ULL << (unit * 10))) {
+        unit++;
+    }
+    
+    if (unit == 0) {
+        ksnprintf(buffer, size, "%uB", (unsigned int)bytes);
+    } else {
+        // Truncated to one decimal: tenths = remainder * 10 / unit size
+        int shift = unit * 10;
+        uint64_t whole = bytes >> shift;
+        uint64_t remainder = bytes & ((1ULL << shift) - 1);
+        unsigned int tenths = (unsigned int)((remainder * 10) >> shift);
+        ksnprintf(buffer, size, "%llu.%u%s", (unsigned long long)whole, tenths, units[unit]);
+    }
+    return buffer;
+}
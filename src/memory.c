@@ -1,225 +1,892 @@
 #include "memory.h"
 #include "display.h"
 #include "string_utils.h"
+#include <stdint.h>
+
+// Threads are preempted from the timer interrupt and tasks run on the
+// application processors, so the heap is only touched with interrupts off
+// and the heap lock held. Hosted builds have nothing to hold off.
+#ifdef MEMORY_HOSTED
+#define heap_lock() 0
+#define heap_unlock(flags) (void)(flags)
+#else
+#include "smp.h"
+static spinlock_t heap_spinlock;
+#define heap_lock() spin_lock_irqsave(&heap_spinlock)
+#define heap_unlock(flags) spin_unlock_irqrestore(&heap_spinlock, flags)
+#endif
+
+#define BLOCK_HEADER_SIZE sizeof(memory_block_t)
+#define DUMP_BATCH 32                   // Blocks memory_dump() copies per lock
+
+// Free-list links stored in the payload of a free block
+typedef struct free_links {
+    memory_block_t* next;
+    memory_block_t* prev;
+} free_links_t;
 
 // Memory pool - static allocation
-static unsigned char memory_pool[MEMORY_POOL_SIZE];
-static memory_block_t* free_list = NULL;
+static unsigned char memory_pool[MEMORY_POOL_SIZE] __attribute__((aligned(MEMORY_ALIGN)));
 static int memory_initialized = 0;
 
+// Heap regions, each holding a chain of blocks ended by a sentinel
+typedef struct memory_region {
+    unsigned char* start;
+    unsigned char* end;
+} memory_region_t;
+
+static memory_region_t regions[MEMORY_MAX_REGIONS];
+static int region_count = 0;
+static memory_grow_fn grow_handler = NULL;
+
+// Running statistics, updated on every list change so queries are O(1)
+static size_t total_bytes = 0;
+static size_t free_bytes = 0;
+static unsigned int free_block_count = 0;
+static size_t peak_used = 0;
+static unsigned int alloc_count = 0;
+static unsigned int free_count = 0;
+static unsigned int fail_count = 0;
+static unsigned int size_histogram[MEMORY_HIST_BUCKETS];
+static int track_callers = 0;
+
+// Segregated free lists with two-level bitmaps for O(1) lookup
+static memory_block_t* free_lists[MEMORY_FL_COUNT][MEMORY_SL_COUNT];
+static unsigned int fl_bitmap = 0;
+static unsigned int sl_bitmap[MEMORY_FL_COUNT];
+
+// Block helpers
+static inline void* block_to_ptr(memory_block_t* block) {
+    return (unsigned char*)block + BLOCK_HEADER_SIZE;
+}
+
+static inline memory_block_t* ptr_to_block(void* ptr) {
+    return (memory_block_t*)((unsigned char*)ptr - BLOCK_HEADER_SIZE);
+}
+
+static inline memory_block_t* block_next_phys(memory_block_t* block) {
+    return (memory_block_t*)((unsigned char*)block + BLOCK_HEADER_SIZE + block->size);
+}
+
+static inline free_links_t* block_links(memory_block_t* block) {
+    return (free_links_t*)block_to_ptr(block);
+}
+
+// The sentinel terminating the pool is a zero-sized block that is never free
+static inline int block_is_sentinel(memory_block_t* block) {
+    return block->size == 0 && !block->free;
+}
+
+// Whether `addr` lies inside one of the heap regions
+static int memory_region_contains(unsigned char* addr) {
+    for (int i = 0; i < region_count; i++) {
+        if (addr >= regions[i].start && addr < regions[i].end) return 1;
+    }
+    return 0;
+}
+
+// Index of the most significant set bit (x must be non-zero)
+static inline int bit_fls(size_t x) {
+    return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)x);
+}
+
+// Index of the least significant set bit (x must be non-zero)
+static inline int bit_ffs(unsigned int x) {
+    return __builtin_ctz(x);
+}
+
+// Map a block size to its (first, second) level bin
+static void mapping_insert(size_t size, int* fl, int* sl) {
+    if (size < MEMORY_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size / (MEMORY_SMALL_BLOCK / MEMORY_SL_COUNT));
+    } else {
+        int bit = bit_fls(size);
+        *sl = (int)(size >> (bit - MEMORY_SL_LOG2)) ^ MEMORY_SL_COUNT;
+        *fl = bit - MEMORY_FL_SHIFT + 1;
+    }
+}
+
+// Map a request size to the first bin whose blocks are all large enough
+static void mapping_search(size_t size, int* fl, int* sl) {
+    if (size >= MEMORY_SMALL_BLOCK) {
+        size += ((size_t)1 << (bit_fls(size) - MEMORY_SL_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+static void insert_free_block(memory_block_t* block) {
+    int fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    
+    free_links_t* links = block_links(block);
+    links->prev = NULL;
+    links->next = free_lists[fl][sl];
+    if (links->next) {
+        block_links(links->next)->prev = block;
+    }
+    free_lists[fl][sl] = block;
+    
+    fl_bitmap |= 1U << fl;
+    sl_bitmap[fl] |= 1U << sl;
+    
+    free_bytes += block->size;
+    free_block_count++;
+}
+
+static void remove_free_block(memory_block_t* block) {
+    int fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    
+    free_links_t* links = block_links(block);
+    if (links->prev) {
+        block_links(links->prev)->next = links->next;
+    } else {
+        free_lists[fl][sl] = links->next;
+    }
+    if (links->next) {
+        block_links(links->next)->prev = links->prev;
+    }
+    
+    free_bytes -= block->size;
+    free_block_count--;
+    
+    if (!free_lists[fl][sl]) {
+        sl_bitmap[fl] &= ~(1U << sl);
+        if (!sl_bitmap[fl]) {
+            fl_bitmap &= ~(1U << fl);
+        }
+    }
+}
+
+// Find a free block of at least `size` bytes using the bitmaps
+static memory_block_t* find_free_block(size_t size) {
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= MEMORY_FL_COUNT) return NULL;
+    
+    unsigned int sl_map = sl_bitmap[fl] & (~0U << sl);
+    if (!sl_map) {
+        unsigned int fl_map = fl_bitmap & (~0U << (fl + 1));
+        if (!fl_map) return NULL;
+        fl = bit_ffs(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    sl = bit_ffs(sl_map);
+    
+    return free_lists[fl][sl];
+}
+
+// Give back the tail of a used block beyond `size`, merging it with a free successor
+static void trim_block(memory_block_t* block, size_t size) {
+    if (block->size < size + BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE) return;
+    
+    memory_block_t* rest = (memory_block_t*)((unsigned char*)block + BLOCK_HEADER_SIZE + size);
+    rest->size = block->size - size - BLOCK_HEADER_SIZE;
+    rest->free = 1;
+    rest->prev_phys = block;
+    block->size = size;
+    
+    memory_block_t* next = block_next_phys(rest);
+    if (next->free) {
+        remove_free_block(next);
+        rest->size += BLOCK_HEADER_SIZE + next->size;
+        next = block_next_phys(rest);
+    }
+    next->prev_phys = rest;
+    
+    insert_free_block(rest);
+}
+
+// Round a request up to the allocation granularity, 0 if it cannot be served
+static size_t adjust_request_size(size_t size) {
+    if (size == 0 || size >= ((size_t)1 << (MEMORY_FL_MAX - 1))) return 0;
+    size = (size + MEMORY_ALIGN - 1) & ~(size_t)(MEMORY_ALIGN - 1);
+    return size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : size;
+}
+
+// Mark a block free, merge it with free neighbours and file it
+static void release_block(memory_block_t* block) {
+    block->free = 1;
+    
+    // Coalesce with next block if free
+    memory_block_t* next = block_next_phys(block);
+    if (next->free) {
+        remove_free_block(next);
+        block->size += BLOCK_HEADER_SIZE + next->size;
+    }
+    
+    // Coalesce with previous block if free
+    memory_block_t* prev = block->prev_phys;
+    if (prev && prev->free) {
+        remove_free_block(prev);
+        prev->size += BLOCK_HEADER_SIZE + block->size;
+        block = prev;
+    }
+    
+    block_next_phys(block)->prev_phys = block;
+    insert_free_block(block);
+}
+
+// Everything that is neither a free block nor a region sentinel is in use
+static size_t used_bytes(void) {
+    return total_bytes - free_bytes - (free_block_count + region_count) * BLOCK_HEADER_SIZE;
+}
+
+static void update_peak(void) {
+    size_t used = used_bytes();
+    if (used > peak_used) peak_used = used;
+}
+
+static int size_bucket(size_t size) {
+    if (size <= MIN_BLOCK_SIZE) return 0;
+    int bucket = bit_fls(size - 1) - 3;
+    return bucket < MEMORY_HIST_BUCKETS ? bucket : MEMORY_HIST_BUCKETS - 1;
+}
+
+// Account for a block just handed out
+static void* record_alloc(memory_block_t* block, size_t request, void* caller) {
+    block->caller = track_callers ? caller : NULL;
+    alloc_count++;
+    size_histogram[size_bucket(request)]++;
+    update_peak();
+    return block_to_ptr(block);
+}
+
+// Lay out one free block over [start, start + size) and end it with a sentinel
+static void region_format(unsigned char* start, size_t size) {
+    memory_block_t* first = (memory_block_t*)start;
+    first->size = size - 2 * BLOCK_HEADER_SIZE;
+    first->free = 1;
+    first->prev_phys = NULL;
+    
+    memory_block_t* sentinel = block_next_phys(first);
+    sentinel->size = 0;
+    sentinel->free = 0;
+    sentinel->prev_phys = first;
+    
+    insert_free_block(first);
+    total_bytes += size;
+}
+
 // Initialize memory management
 void memory_init(void) {
     if (memory_initialized) return;
     
-    // Create initial free block covering entire pool
-    free_list = (memory_block_t*)memory_pool;
-    free_list->size = MEMORY_POOL_SIZE - sizeof(memory_block_t);
-    free_list->free = 1;
-    free_list->next = NULL;
-    free_list->prev = NULL;
+    region_format(memory_pool, MEMORY_POOL_SIZE);
+    regions[0].start = memory_pool;
+    regions[0].end = memory_pool + MEMORY_POOL_SIZE;
+    region_count = 1;
     
     memory_initialized = 1;
 }
 
-// Allocate memory
-void* malloc(size_t size) {
-    if (!memory_initialized) {
-        memory_init();
+// Hand a range of memory to the heap. A range that starts where an existing
+// region ends extends it, so its sentinel becomes an ordinary block.
+int memory_add_region(void* start, size_t size) {
+    if (!memory_initialized) memory_init();
+    
+    size_t base = ((size_t)start + MEMORY_ALIGN - 1) & ~(size_t)(MEMORY_ALIGN - 1);
+    if (size < base - (size_t)start) return 0;
+    size = (size - (base - (size_t)start)) & ~(size_t)(MEMORY_ALIGN - 1);
+    if (size > MEMORY_REGION_MAX) size = MEMORY_REGION_MAX;
+    
+    // Room for at least one block and a sentinel, extending or not
+    if (size < 2 * BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE) return 0;
+    
+    for (int i = 0; i < region_count; i++) {
+        memory_region_t* region = &regions[i];
+        if ((size_t)region->end != base) continue;
+        if ((size_t)(region->end - region->start) + size > MEMORY_REGION_MAX) break;
+        
+        memory_block_t* block = (memory_block_t*)(region->end - BLOCK_HEADER_SIZE);
+        block->size = size - BLOCK_HEADER_SIZE;
+        region->end += size;
+        total_bytes += size;
+        
+        memory_block_t* sentinel = block_next_phys(block);
+        sentinel->size = 0;
+        sentinel->free = 0;
+        sentinel->prev_phys = block;
+        
+        release_block(block); // Coalesces with a free predecessor
+        return 1;
     }
     
-    if (size == 0) return NULL;
+    if (region_count >= MEMORY_MAX_REGIONS) return 0;
     
-    // Align size to 16 bytes
-    size = (size + 15) & ~15;
+    region_format((unsigned char*)base, size);
+    regions[region_count].start = (unsigned char*)base;
+    regions[region_count].end = (unsigned char*)base + size;
+    region_count++;
     
-    memory_block_t* current = free_list;
+    return 1;
+}
+
+// Set the callback used to grow the heap when it runs out of memory
+void memory_set_grow_handler(memory_grow_fn handler) {
+    grow_handler = handler;
+}
+
+// Ask the grow handler for enough memory to satisfy a `size`-byte request
+static int memory_grow(size_t size) {
+    if (!grow_handler) return 0;
     
-    // Find first suitable block using first-fit algorithm
-    while (current != NULL) {
-        if (current->free && current->size >= size) {
-            // Found suitable block
-            if (current->size >= size + sizeof(memory_block_t) + MIN_BLOCK_SIZE) {
-                // Split block if there's enough space
-                memory_block_t* new_block = (memory_block_t*)((unsigned char*)current + sizeof(memory_block_t) + size);
-                new_block->size = current->size - size - sizeof(memory_block_t);
-                new_block->free = 1;
-                new_block->next = current->next;
-                new_block->prev = current;
-                
-                if (current->next) {
-                    current->next->prev = new_block;
-                }
-                
-                current->size = size;
-                current->next = new_block;
-            }
-            
-            current->free = 0;
-            return (unsigned char*)current + sizeof(memory_block_t);
-        }
-        current = current->next;
+    // Headroom for the bin rounding in mapping_search and the new headers
+    size_t bytes = size + (size >> MEMORY_SL_LOG2) + 3 * BLOCK_HEADER_SIZE + MEMORY_ALIGN;
+    void* start = grow_handler(&bytes);
+    if (!start) return 0;
+    
+    return memory_add_region(start, bytes);
+}
+
+// Find a free block, growing the heap once if none is large enough
+static memory_block_t* find_or_grow(size_t size) {
+    memory_block_t* block = find_free_block(size);
+    if (!block && memory_grow(size)) {
+        block = find_free_block(size);
+    }
+    return block;
+}
+
+// Allocate `request` bytes on behalf of `caller`
+static void* allocate(size_t request, void* caller) {
+    if (!memory_initialized) {
+        memory_init();
     }
     
-    // No suitable block found
-    shell_print_string("malloc: Out of memory!\n");
-    return NULL;
+    if (request == 0) return NULL;
+    size_t size = adjust_request_size(request);
+    if (size == 0) {
+        fail_count++;
+        return NULL;
+    }
+    
+    memory_block_t* block = find_or_grow(size);
+    if (!block) {
+        // No suitable block found; `memory stats` shows the failure
+        fail_count++;
+        return NULL;
+    }
+    
+    remove_free_block(block);
+    block->free = 0;
+    trim_block(block, size);
+    
+    return record_alloc(block, request, caller);
 }
 
-// Free allocated memory
-void free(void* ptr) {
-    if (!ptr) return;
+// Payload aligned to `align` (a power of two)
+static void* allocate_aligned(size_t size, size_t align, void* caller) {
+    if (align <= MEMORY_ALIGN) return allocate(size, caller);
+    if (align & (align - 1)) return NULL;
+    
+    if (!memory_initialized) {
+        memory_init();
+    }
     
-    memory_block_t* block = (memory_block_t*)((unsigned char*)ptr - sizeof(memory_block_t));
+    size_t request_size = size;
+    if (request_size == 0) return NULL;
+    size = adjust_request_size(size);
     
-    if ((unsigned char*)block < memory_pool || 
-        (unsigned char*)block >= memory_pool + MEMORY_POOL_SIZE) {
-        shell_print_string("free: Invalid pointer!\n");
-        return;
+    // Reserve enough slack to carve a free block off the front if needed
+    size_t gap_min = BLOCK_HEADER_SIZE + MIN_BLOCK_SIZE;
+    size_t request = size ? adjust_request_size(size + align + gap_min) : 0;
+    if (request == 0) {
+        fail_count++;
+        return NULL;
     }
     
-    block->free = 1;
+    memory_block_t* block = find_or_grow(request);
+    if (!block) {
+        fail_count++;
+        return NULL;
+    }
+    remove_free_block(block);
     
-    // Coalesce with next block if free
-    if (block->next && block->next->free) {
-        block->size += sizeof(memory_block_t) + block->next->size;
-        block->next = block->next->next;
-        if (block->next) {
-            block->next->prev = block;
-        }
+    size_t ptr = (size_t)block_to_ptr(block);
+    size_t aligned = (ptr + align - 1) & ~(align - 1);
+    if (aligned != ptr && aligned - ptr < gap_min) {
+        aligned = (ptr + gap_min + align - 1) & ~(align - 1);
     }
     
-    // Coalesce with previous block if free
-    if (block->prev && block->prev->free) {
-        block->prev->size += sizeof(memory_block_t) + block->size;
-        block->prev->next = block->next;
-        if (block->next) {
-            block->next->prev = block->prev;
-        }
+    if (aligned != ptr) {
+        // Split off the leading gap as its own free block
+        memory_block_t* aligned_block = ptr_to_block((void*)aligned);
+        aligned_block->size = block->size - (aligned - ptr);
+        aligned_block->prev_phys = block;
+        block_next_phys(aligned_block)->prev_phys = aligned_block;
+        
+        block->size = aligned - ptr - BLOCK_HEADER_SIZE;
+        insert_free_block(block);
+        block = aligned_block;
     }
+    
+    block->free = 0;
+    trim_block(block, size);
+    
+    return record_alloc(block, request_size, caller);
 }
 
-// Allocate and zero memory
-void* calloc(size_t num, size_t size) {
-    size_t total_size = num * size;
-    void* ptr = malloc(total_size);
+// NULL, or what was wrong with `ptr` for the caller to report
+static const char* release(void* ptr) {
+    if (!ptr) return NULL;
     
-    if (ptr) {
-        unsigned char* byte_ptr = (unsigned char*)ptr;
-        for (size_t i = 0; i < total_size; i++) {
-            byte_ptr[i] = 0;
-        }
+    memory_block_t* block = ptr_to_block(ptr);
+    
+    if (!memory_region_contains((unsigned char*)block)) {
+        return "free: Invalid pointer!\n";
     }
     
-    return ptr;
+    if (block->free) {
+        return "free: Double free detected!\n";
+    }
+    
+    free_count++;
+    release_block(block);
+    return NULL;
 }
 
-// Reallocate memory
-void* realloc(void* ptr, size_t new_size) {
-    if (!ptr) return malloc(new_size);
+static void* reallocate(void* ptr, size_t new_size, void* caller) {
+    if (!ptr) return allocate(new_size, caller);
     if (new_size == 0) {
-        free(ptr);
+        release(ptr);
         return NULL;
     }
     
-    memory_block_t* block = (memory_block_t*)((unsigned char*)ptr - sizeof(memory_block_t));
+    memory_block_t* block = ptr_to_block(ptr);
+    size_t size = adjust_request_size(new_size);
+    if (size == 0) {
+        fail_count++;
+        return NULL;
+    }
     
-    if (block->size >= new_size) {
-        return ptr; // Current block is large enough
+    if (block->size >= size) {
+        trim_block(block, size); // Shrink in place
+        return ptr;
     }
     
-    void* new_ptr = malloc(new_size);
+    // Grow in place by absorbing a free successor
+    memory_block_t* next = block_next_phys(block);
+    if (next->free && block->size + BLOCK_HEADER_SIZE + next->size >= size) {
+        remove_free_block(next);
+        block->size += BLOCK_HEADER_SIZE + next->size;
+        block_next_phys(block)->prev_phys = block;
+        trim_block(block, size);
+        update_peak();
+        return ptr;
+    }
+    
+    void* new_ptr = allocate(new_size, caller);
     if (new_ptr) {
-        // Copy old data
-        unsigned char* src = (unsigned char*)ptr;
-        unsigned char* dst = (unsigned char*)new_ptr;
-        size_t copy_size = (block->size < new_size) ? block->size : new_size;
-        
-        for (size_t i = 0; i < copy_size; i++) {
-            dst[i] = src[i];
-        }
-        
-        free(ptr);
+        memcpy(new_ptr, ptr, block->size);
+        release(ptr);
     }
     
     return new_ptr;
 }
 
-// Get free memory size
-size_t memory_get_free(void) {
-    if (!memory_initialized) memory_init();
+// The console is not SMP-safe: print only on the boot processor, and
+// never with the heap lock held
+static void report(const char* message) {
+#ifndef MEMORY_HOSTED
+    if (smp_cpu_index() != 0) return;
+#endif
+    shell_print_string(message);
+}
+
+// Allocate memory
+void* malloc(size_t size) {
+    uint32_t flags = heap_lock();
+    void* ptr = allocate(size, __builtin_return_address(0));
+    heap_unlock(flags);
+    return ptr;
+}
+
+// Allocate memory whose payload is aligned to `align` (a power of two)
+void* malloc_aligned(size_t size, size_t align) {
+    uint32_t flags = heap_lock();
+    void* ptr = allocate_aligned(size, align, __builtin_return_address(0));
+    heap_unlock(flags);
+    return ptr;
+}
+
+// Free allocated memory
+void free(void* ptr) {
+    uint32_t flags = heap_lock();
+    const char* error = release(ptr);
+    heap_unlock(flags);
+    if (error) report(error);
+}
+
+// Allocate and zero memory
+void* calloc(size_t num, size_t size) {
+    if (size && num > (size_t)-1 / size) return NULL;
     
-    size_t free_size = 0;
-    memory_block_t* current = free_list;
+    size_t total_size = num * size;
+    uint32_t flags = heap_lock();
+    void* ptr = allocate(total_size, __builtin_return_address(0));
+    heap_unlock(flags);
     
-    while (current != NULL) {
-        if (current->free) {
-            free_size += current->size;
-        }
-        current = current->next;
+    if (ptr) {
+        memset(ptr, 0, total_size);
     }
     
-    return free_size;
+    return ptr;
+}
+
+// Reallocate memory
+void* realloc(void* ptr, size_t new_size) {
+    uint32_t flags = heap_lock();
+    void* new_ptr = reallocate(ptr, new_size, __builtin_return_address(0));
+    heap_unlock(flags);
+    return new_ptr;
+}
+
+// The readers below take the heap lock like the allocator does and print
+// only after dropping it, from what they copied out.
+
+// Get free memory size
+size_t memory_get_free(void) {
+    uint32_t flags = heap_lock();
+    if (!memory_initialized) memory_init();
+    size_t bytes = free_bytes;
+    heap_unlock(flags);
+    return bytes;
 }
 
 // Get used memory size
 size_t memory_get_used(void) {
+    uint32_t flags = heap_lock();
     if (!memory_initialized) memory_init();
+    size_t bytes = used_bytes();
+    heap_unlock(flags);
+    return bytes;
+}
+
+// Get total memory size
+size_t memory_get_total(void) {
+    uint32_t flags = heap_lock();
+    if (!memory_initialized) memory_init();
+    size_t bytes = total_bytes;
+    heap_unlock(flags);
+    return bytes;
+}
+
+// Biggest free block. Blocks within one bin differ in size, so the
+// highest non-empty bin has to be scanned.
+static size_t largest_free_block(void) {
+    if (!fl_bitmap) return 0;
     
-    size_t used_size = 0;
-    memory_block_t* current = (memory_block_t*)memory_pool;
-    
-    while ((unsigned char*)current < memory_pool + MEMORY_POOL_SIZE) {
-        if (!current->free) {
-            used_size += current->size + sizeof(memory_block_t);
-        }
-        
-        if (current->next == NULL) break;
-        current = current->next;
+    int fl = bit_fls(fl_bitmap);
+    int sl = bit_fls(sl_bitmap[fl]);
+    size_t largest = 0;
+    for (memory_block_t* b = free_lists[fl][sl]; b; b = block_links(b)->next) {
+        if (b->size > largest) largest = b->size;
     }
+    return largest;
+}
+
+// Snapshot of all counters
+void memory_get_stats(memory_stats_t* stats) {
+    uint32_t flags = heap_lock();
+    if (!memory_initialized) memory_init();
     
-    return used_size;
+    stats->total = total_bytes;
+    stats->used = used_bytes();
+    stats->free = free_bytes;
+    stats->peak = peak_used;
+    stats->largest_free = largest_free_block();
+    stats->regions = region_count;
+    stats->free_blocks = free_block_count;
+    stats->allocs = alloc_count;
+    stats->frees = free_count;
+    stats->failures = fail_count;
+    for (int i = 0; i < MEMORY_HIST_BUCKETS; i++) {
+        stats->histogram[i] = size_histogram[i];
+    }
+    heap_unlock(flags);
 }
 
-// Get total memory size
-size_t memory_get_total(void) {
-    return MEMORY_POOL_SIZE;
+// Record the call site of each allocation from now on
+void memory_set_caller_tracking(int enabled) {
+    track_callers = enabled;
+}
+
+int memory_get_caller_tracking(void) {
+    return track_callers;
+}
+
+// Copy up to DUMP_BATCH blocks, starting with block number `first`
+typedef struct {
+    int region;
+    size_t size;
+    int free;
+} dump_entry_t;
+
+static int dump_batch(int first, dump_entry_t* batch) {
+    int count = 0;
+    for (int i = 0; i < region_count && count < DUMP_BATCH; i++) {
+        memory_block_t* current = (memory_block_t*)regions[i].start;
+        for (; !block_is_sentinel(current) && count < DUMP_BATCH; current = block_next_phys(current)) {
+            if (first) {
+                first--;
+                continue;
+            }
+            batch[count].region = i;
+            batch[count].size = current->size;
+            batch[count].free = current->free;
+            count++;
+        }
+    }
+    return count;
 }
 
-// Debug: dump memory blocks
+// Debug: dump memory blocks. The heap may change between batches, but
+// each batch is a consistent copy.
 void memory_dump(void) {
-    shell_print_string("Memory dump:\n");
-    memory_block_t* current = (memory_block_t*)memory_pool;
+    dump_entry_t batch[DUMP_BATCH];
     int block_num = 0;
+    int shown_region = -1;
     
-    while ((unsigned char*)current < memory_pool + MEMORY_POOL_SIZE) {
-        char buffer[64];
-        shell_print_string("Block ");
-        itoa(block_num++, buffer);
-        shell_print_string(buffer);
-        shell_print_string(": size=");
-        itoa(current->size, buffer);
-        shell_print_string(buffer);
-        shell_print_string(" free=");
-        shell_print_string(current->free ? "yes" : "no");
-        shell_print_string("\n");
+    shell_print_string("Memory dump:\n");
+    
+    for (;;) {
+        uint32_t flags = heap_lock();
+        if (!memory_initialized) memory_init();
+        int count = dump_batch(block_num, batch);
+        unsigned char* region_start[MEMORY_MAX_REGIONS];
+        for (int i = 0; i < region_count; i++) {
+            region_start[i] = regions[i].start;
+        }
+        heap_unlock(flags);
+        
+        for (int n = 0; n < count; n++) {
+            char buffer[64];
+            if (batch[n].region != shown_region) {
+                shown_region = batch[n].region;
+                shell_print_string("Region ");
+                itoa(shown_region, buffer);
+                shell_print_string(buffer);
+                shell_print_string(" at 0x");
+                itoa_hex((size_t)region_start[shown_region], buffer);
+                shell_print_string(buffer);
+                shell_print_string(":\n");
+            }
+            
+            shell_print_string("Block ");
+            itoa(block_num++, buffer);
+            shell_print_string(buffer);
+            shell_print_string(": size=");
+            itoa(batch[n].size, buffer);
+            shell_print_string(buffer);
+            shell_print_string(" free=");
+            shell_print_string(batch[n].free ? "yes" : "no");
+            shell_print_string("\n");
+        }
+        if (count < DUMP_BATCH) break;
+    }
+}
+
+// Walk every chain and free list; the heap lock is held
+static int check_integrity(void) {
+    size_t listed_bytes = 0;
+    unsigned int listed_blocks = 0;
+    
+    // Physical chains: sizes in bounds, back links intact, no free neighbours
+    for (int i = 0; i < region_count; i++) {
+        unsigned char* last = regions[i].end - BLOCK_HEADER_SIZE;
+        memory_block_t* current = (memory_block_t*)regions[i].start;
+        memory_block_t* prev = NULL;
         
-        if (current->next == NULL) break;
-        current = current->next;
+        while (!block_is_sentinel(current)) {
+            if ((unsigned char*)current + BLOCK_HEADER_SIZE + current->size > last) {
+                return 0; // Invalid block
+            }
+            if (current->prev_phys != prev) return 0;
+            if (prev && prev->free && current->free) return 0;
+            if (current->free) {
+                listed_bytes += current->size;
+                listed_blocks++;
+            }
+            
+            prev = current;
+            current = block_next_phys(current);
+        }
+        if ((unsigned char*)current != last || current->prev_phys != prev) return 0;
     }
+    
+    // Running counters agree with the heap
+    if (listed_bytes != free_bytes || listed_blocks != free_block_count) return 0;
+    
+    // Free lists: every entry is free and filed under its own size class
+    for (int fl = 0; fl < MEMORY_FL_COUNT; fl++) {
+        for (int sl = 0; sl < MEMORY_SL_COUNT; sl++) {
+            unsigned int listed = free_lists[fl][sl] != NULL;
+            if (listed != ((sl_bitmap[fl] >> sl) & 1)) return 0;
+            
+            for (memory_block_t* b = free_lists[fl][sl]; b; b = block_links(b)->next) {
+                int bfl, bsl;
+                mapping_insert(b->size, &bfl, &bsl);
+                if (!b->free || bfl != fl || bsl != sl) return 0;
+            }
+        }
+        if (((fl_bitmap >> fl) & 1) != (sl_bitmap[fl] != 0)) return 0;
+    }
+    
+    return 1; // Memory is valid
 }
 
 // Debug: check memory integrity
 int memory_check_integrity(void) {
-    memory_block_t* current = (memory_block_t*)memory_pool;
+    uint32_t flags = heap_lock();
+    if (!memory_initialized) memory_init();
+    int valid = check_integrity();
+    heap_unlock(flags);
+    return valid;
+}
+
+// Print a byte count in the largest unit that keeps it readable
+static void print_size(size_t bytes) {
+    char buffer[16];
+    if (bytes >= 10 * 1024 * 1024) {
+        itoa(bytes / (1024 * 1024), buffer);
+        shell_print_string(buffer);
+        shell_print_string(" MB");
+    } else if (bytes >= 10 * 1024) {
+        itoa(bytes / 1024, buffer);
+        shell_print_string(buffer);
+        shell_print_string(" KB");
+    } else {
+        itoa(bytes, buffer);
+        shell_print_string(buffer);
+        shell_print_string(" B");
+    }
+}
+
+// Debug: print counters and the allocation size histogram
+void memory_dump_stats(void) {
+    memory_stats_t stats;
+    char buffer[16];
+    
+    memory_get_stats(&stats);
+    
+    shell_print_string("Heap: ");
+    print_size(stats.used);
+    shell_print_string(" used, ");
+    print_size(stats.free);
+    shell_print_string(" free, ");
+    print_size(stats.total);
+    shell_print_string(" total in ");
+    itoa(stats.regions, buffer);
+    shell_print_string(buffer);
+    shell_print_string(" region(s)\n");
+    
+    shell_print_string("Peak: ");
+    print_size(stats.peak);
+    shell_print_string("  Largest free: ");
+    print_size(stats.largest_free);
+    shell_print_string("  Free blocks: ");
+    itoa(stats.free_blocks, buffer);
+    shell_print_string(buffer);
+    shell_print_string("\n");
+    
+    shell_print_string("Allocs: ");
+    itoa(stats.allocs, buffer);
+    shell_print_string(buffer);
+    shell_print_string("  Frees: ");
+    itoa(stats.frees, buffer);
+    shell_print_string(buffer);
+    shell_print_string("  Failures: ");
+    itoa(stats.failures, buffer);
+    shell_print_string(buffer);
+    shell_print_string("\n");
+    
+    shell_print_string("Request sizes:\n");
+    for (int i = 0; i < MEMORY_HIST_BUCKETS; i++) {
+        if (stats.histogram[i] == 0) continue;
+        
+        shell_print_string(i == MEMORY_HIST_BUCKETS - 1 ? "  >" : "  <=");
+        print_size((size_t)MIN_BLOCK_SIZE << (i == MEMORY_HIST_BUCKETS - 1 ? i - 1 : i));
+        shell_print_string(": ");
+        itoa(stats.histogram[i], buffer);
+        shell_print_string(buffer);
+        shell_print_string("\n");
+    }
+}
+
+// Debug: live allocations grouped by call site (needs caller tracking)
+void memory_dump_callers(void) {
+    void* callers[MEMORY_MAX_CALLERS];
+    unsigned int counts[MEMORY_MAX_CALLERS];
+    size_t bytes[MEMORY_MAX_CALLERS];
+    int caller_count = 0;
+    unsigned int untagged = 0;
+    char buffer[16];
     
-    while ((unsigned char*)current < memory_pool + MEMORY_POOL_SIZE) {
-        if ((unsigned char*)current + sizeof(memory_block_t) + current->size > memory_pool + MEMORY_POOL_SIZE) {
-            return 0; // Invalid block
+    uint32_t flags = heap_lock();
+    if (!memory_initialized) memory_init();
+    
+    for (int i = 0; i < region_count; i++) {
+        memory_block_t* current = (memory_block_t*)regions[i].start;
+        
+        for (; !block_is_sentinel(current); current = block_next_phys(current)) {
+            if (current->free) continue;
+            if (!current->caller) {
+                untagged++;
+                continue;
+            }
+            
+            int slot = 0;
+            while (slot < caller_count && callers[slot] != current->caller) slot++;
+            if (slot == caller_count) {
+                if (caller_count == MEMORY_MAX_CALLERS) {
+                    untagged++;
+                    continue;
+                }
+                callers[slot] = current->caller;
+                counts[slot] = 0;
+                bytes[slot] = 0;
+                caller_count++;
+            }
+            counts[slot]++;
+            bytes[slot] += current->size;
         }
+    }
+    heap_unlock(flags);
+    
+    shell_print_string("Live allocations by call site:\n");
+    // Largest first
+    for (int n = 0; n < caller_count; n++) {
+        int best = n;
+        for (int j = n + 1; j < caller_count; j++) {
+            if (bytes[j] > bytes[best]) best = j;
+        }
+        void* caller = callers[n];
+        unsigned int count = counts[n];
+        size_t size = bytes[n];
+        callers[n] = callers[best];
+        counts[n] = counts[best];
+        bytes[n] = bytes[best];
+        callers[best] = caller;
+        counts[best] = count;
+        bytes[best] = size;
         
-        if (current->next == NULL) break;
-        current = current->next;
+        shell_print_string("  0x");
+        itoa_hex((size_t)callers[n], buffer);
+        shell_print_string(buffer);
+        shell_print_string("  ");
+        itoa(counts[n], buffer);
+        shell_print_string(buffer);
+        shell_print_string(" block(s), ");
+        print_size(bytes[n]);
+        shell_print_string("\n");
     }
     
-    return 1; // Memory is valid
-}
\ No newline at end of file
+    if (untagged) {
+        shell_print_string("  untagged: ");
+        itoa(untagged, buffer);
+        shell_print_string(buffer);
+        shell_print_string(" block(s)\n");
+    }
+}
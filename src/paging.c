@@ -0,0 +1,306 @@
+#include "paging.h"
+#include "pmm.h"
+#include "memory.h"
+#include "io.h"
+#include "display.h"
+#include "string_utils.h"
+#include "hardware_detection.h"
+
+// Set by the linker script
+extern char kernel_end[];
+
+#define MSR_PAT 0x277
+#define PAT_TYPE_WC 0x01
+#define PAT_WC_SHIFT 32             // PAT entry 4: PAT=1, PCD=0, PWT=0
+
+#define CR0_WP 0x00010000
+#define CR0_PG 0x80000000
+#define CR4_PSE 0x00000010
+#define CR4_PGE 0x00000080
+
+#define VGA_TEXT_BUFFER 0xB8000
+#define VGA_TEXT_SIZE 0x8000        // B8000-BFFFF
+
+static uint32_t page_directory[PAGE_TABLE_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t low_page_table[PAGE_TABLE_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+static int paging_on = 0;
+static int has_pse = 0;
+static int has_pge = 0;
+static int has_pat = 0;
+static uint32_t global_flag = 0;
+
+static inline void invlpg(uint32_t addr) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline void write_cr3(uint32_t value) {
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline void write_cr4(uint32_t value) {
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+// Flush every TLB entry, including global ones
+static void tlb_flush_all(void) {
+    if (!paging_on) return;
+    
+    if (has_pge) {
+        uint32_t cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        write_cr3((uint32_t)page_directory);
+    }
+}
+
+static void tlb_flush_page(uint32_t addr) {
+    if (paging_on) invlpg(addr);
+}
+
+// PTE/PDE bits selecting a memory type
+static uint32_t cache_bits(page_cache_t cache, int large) {
+    switch (cache) {
+        case PAGE_CACHE_WC:
+            if (has_pat) return large ? PAGE_LARGE_PAT : PAGE_PAT;
+            return PAGE_CACHE_DISABLE | PAGE_WRITE_THROUGH; // No PAT: fall back to UC
+        case PAGE_CACHE_UC:
+            return PAGE_CACHE_DISABLE | PAGE_WRITE_THROUGH;
+        default:
+            return 0;
+    }
+}
+
+// Page tables come from the frame allocator, or the heap before it has a map
+static uint32_t* alloc_page_table(void) {
+    uint32_t* table = (uint32_t*)pmm_alloc_frame();
+    if (!table) {
+        table = (uint32_t*)malloc_aligned(PAGE_SIZE, PAGE_SIZE);
+    }
+    if (table) {
+        memset(table, 0, PAGE_SIZE);
+    }
+    return table;
+}
+
+// Replace a 4MB page by an equivalent table of 4KB pages
+static uint32_t* split_large_page(int index) {
+    uint32_t pde = page_directory[index];
+    uint32_t* table = alloc_page_table();
+    if (!table) return NULL;
+    
+    // Carry the attributes over; the PAT bit moves from bit 12 to bit 7
+    uint32_t flags = pde & (PAGE_WRITE | PAGE_USER | PAGE_WRITE_THROUGH | PAGE_CACHE_DISABLE | PAGE_GLOBAL);
+    if (pde & PAGE_LARGE_PAT) flags |= PAGE_PAT;
+    
+    uint32_t base = pde & PAGE_LARGE_MASK;
+    for (int i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        table[i] = (base + i * PAGE_SIZE) | flags | PAGE_PRESENT;
+    }
+    
+    page_directory[index] = (uint32_t)table | PAGE_PRESENT | PAGE_WRITE | (pde & PAGE_USER);
+    tlb_flush_all();
+    return table;
+}
+
+// Page table covering `virt`, created or split out of a large page if asked
+static uint32_t* get_page_table(uint32_t virt, int create) {
+    int index = virt >> 22;
+    uint32_t pde = page_directory[index];
+    
+    if (pde & PAGE_PRESENT) {
+        if (!(pde & PAGE_LARGE)) return (uint32_t*)(pde & PAGE_FRAME_MASK);
+        return create ? split_large_page(index) : NULL;
+    }
+    if (!create) return NULL;
+    
+    uint32_t* table = alloc_page_table();
+    if (!table) return NULL;
+    page_directory[index] = (uint32_t)table | PAGE_PRESENT | PAGE_WRITE;
+    return table;
+}
+
+// Map one 4KB page with raw PTE flags
+int paging_map_page(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t* table = get_page_table(virt, 1);
+    if (!table) return 0;
+    
+    table[(virt >> 12) & 0x3FF] = (phys & PAGE_FRAME_MASK) | (flags & 0xFFF) | PAGE_PRESENT;
+    tlb_flush_page(virt);
+    return 1;
+}
+
+// Map a range, using 4MB pages wherever alignment and the directory allow
+int paging_map_range(uint32_t virt, uint32_t phys, size_t size, page_cache_t cache) {
+    size += virt & (PAGE_SIZE - 1);
+    size = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    virt &= PAGE_FRAME_MASK;
+    phys &= PAGE_FRAME_MASK;
+    
+    while (size > 0) {
+        uint32_t pde = page_directory[virt >> 22];
+        if (has_pse && size >= LARGE_PAGE_SIZE &&
+            !(virt & ~PAGE_LARGE_MASK) && !(phys & ~PAGE_LARGE_MASK) &&
+            (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE))) {
+            page_directory[virt >> 22] = phys | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE |
+                                         global_flag | cache_bits(cache, 1);
+            tlb_flush_page(virt);
+            virt += LARGE_PAGE_SIZE;
+            phys += LARGE_PAGE_SIZE;
+            size -= LARGE_PAGE_SIZE;
+            continue;
+        }
+        
+        if (!paging_map_page(virt, phys, PAGE_WRITE | global_flag | cache_bits(cache, 0))) {
+            return 0;
+        }
+        virt += PAGE_SIZE;
+        phys += PAGE_SIZE;
+        size -= PAGE_SIZE;
+    }
+    
+    return 1;
+}
+
+// Identity-map device registers, uncached
+int paging_map_mmio(uint32_t phys, size_t size) {
+    return paging_map_range(phys, phys, size, PAGE_CACHE_UC);
+}
+
+// Identity-map a frame buffer, write-combining
+int paging_map_wc(uint32_t phys, size_t size) {
+    return paging_map_range(phys, phys, size, PAGE_CACHE_WC);
+}
+
+// Remove the mapping of one 4KB page
+void paging_unmap_page(uint32_t virt) {
+    uint32_t* table = get_page_table(virt, (page_directory[virt >> 22] & PAGE_LARGE) != 0);
+    if (!table) return;
+    
+    table[(virt >> 12) & 0x3FF] = 0;
+    tlb_flush_page(virt);
+}
+
+// Translate a virtual address, 0 if unmapped
+uint32_t paging_get_physical(uint32_t virt) {
+    uint32_t pde = page_directory[virt >> 22];
+    if (!(pde & PAGE_PRESENT)) return 0;
+    if (pde & PAGE_LARGE) return (pde & PAGE_LARGE_MASK) | (virt & ~PAGE_LARGE_MASK);
+    
+    uint32_t pte = ((uint32_t*)(pde & PAGE_FRAME_MASK))[(virt >> 12) & 0x3FF];
+    if (!(pte & PAGE_PRESENT)) return 0;
+    return (pte & PAGE_FRAME_MASK) | (virt & (PAGE_SIZE - 1));
+}
+
+// A locked instruction drains the write-combining buffers
+void paging_flush_wc(void) {
+    __asm__ volatile ("lock; orl $0, (%%esp)" : : : "memory");
+}
+
+int paging_enabled(void) {
+    return paging_on;
+}
+
+// Entry 4 (PAT bit alone) defaults to WB; make it write-combining. Every
+// CPU has its own PAT, so this runs on each of them.
+static void program_pat(void) {
+    if (!has_pat) return;
+    uint64_t pat = rdmsr(MSR_PAT);
+    pat &= ~(0xFFULL << PAT_WC_SHIFT);
+    pat |= (uint64_t)PAT_TYPE_WC << PAT_WC_SHIFT;
+    wrmsr(MSR_PAT, pat);
+}
+
+// Application processors share the page tables and get CR0/CR3/CR4 from
+// the startup code; only the PAT is left to set
+void paging_init_cpu(void) {
+    program_pat();
+}
+
+// Identity-map RAM and turn paging on
+void paging_init(void) {
+    if (paging_on) return;
+    
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    has_pse = (edx >> 3) & 1;
+    has_pge = (edx >> 13) & 1;
+    has_pat = (edx >> 16) & 1;
+    if (has_pge) global_flag = PAGE_GLOBAL;
+    
+    program_pat();
+    
+    // The first 4MB goes through a page table so low memory can carry
+    // per-page attributes (VGA, BIOS areas)
+    for (int i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        low_page_table[i] = (i * PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITE | global_flag;
+    }
+    page_directory[0] = (uint32_t)low_page_table | PAGE_PRESENT | PAGE_WRITE;
+    
+    // Everything above it with large pages, up to the end of usable RAM
+    uint64_t end = pmm_get_memory_end();
+    if (end < (uint32_t)kernel_end) end = (uint32_t)kernel_end;
+    end = (end + LARGE_PAGE_SIZE - 1) & ~(uint64_t)(LARGE_PAGE_SIZE - 1);
+    if (end > IDENTITY_MAP_LIMIT) end = IDENTITY_MAP_LIMIT;
+    if (end > LARGE_PAGE_SIZE) {
+        paging_map_range(LARGE_PAGE_SIZE, LARGE_PAGE_SIZE, (size_t)(end - LARGE_PAGE_SIZE), PAGE_CACHE_WB);
+    }
+    
+    paging_map_wc(VGA_TEXT_BUFFER, VGA_TEXT_SIZE);
+    
+    uint32_t cr4 = read_cr4();
+    if (has_pse) cr4 |= CR4_PSE;
+    if (has_pge) cr4 |= CR4_PGE;
+    write_cr4(cr4);
+    
+    write_cr3((uint32_t)page_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+    paging_on = 1;
+}
+
+// Debug: print paging mode and mapping counts
+void paging_dump_info(void) {
+    char buffer[16];
+    int large = 0;
+    int tables = 0;
+    
+    for (int i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        if (!(page_directory[i] & PAGE_PRESENT)) continue;
+        if (page_directory[i] & PAGE_LARGE) {
+            large++;
+        } else {
+            tables++;
+        }
+    }
+    
+    shell_print_string("Paging: ");
+    shell_print_string(paging_on ? "enabled" : "disabled");
+    shell_print_string(", 4MB pages: ");
+    shell_print_string(has_pse ? "yes" : "no");
+    shell_print_string(", write-combining: ");
+    shell_print_string(has_pat ? "yes" : "no");
+    shell_print_string("\nMappings: ");
+    itoa(large, buffer);
+    shell_print_string(buffer);
+    shell_print_string(" large pages, ");
+    itoa(tables, buffer);
+    shell_print_string(buffer);
+    shell_print_string(" page tables\n");
+}
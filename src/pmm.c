@@ -0,0 +1,351 @@
+#include "pmm.h"
+#include "paging.h"
+#include "display.h"
+#include "string_utils.h"
+
+// Set by the linker script
+extern char kernel_start[];
+extern char kernel_end[];
+
+#define LOW_MEMORY_END 0x100000     // BIOS, VGA and option ROMs live below 1MB
+#define FRAMES_PER_WORD 32
+
+// One bit per frame, 1 = used. Placed right after the kernel image.
+static uint32_t* frame_bitmap = NULL;
+static uint32_t frame_count = 0;
+static uint32_t free_frames = 0;
+static uint32_t search_hint = 0;    // Word index where the last free frame was found
+
+// Copy of the boot loader map, kept for reporting
+static pmm_region_t regions[PMM_MAX_REGIONS];
+static int region_count = 0;
+static size_t usable_bytes = 0;
+
+// What the boot loader left in memory besides the kernel: boot info,
+// memory map, strings, modules and VBE blocks
+typedef struct {
+    uint32_t base;
+    uint32_t length;
+} boot_range_t;
+
+static boot_range_t boot_ranges[PMM_MAX_BOOT_RANGES];
+static int boot_range_count = 0;
+
+static inline void frame_set(uint32_t frame) {
+    frame_bitmap[frame / FRAMES_PER_WORD] |= 1U << (frame % FRAMES_PER_WORD);
+}
+
+static inline void frame_clear(uint32_t frame) {
+    frame_bitmap[frame / FRAMES_PER_WORD] &= ~(1U << (frame % FRAMES_PER_WORD));
+}
+
+static inline int frame_test(uint32_t frame) {
+    return (frame_bitmap[frame / FRAMES_PER_WORD] >> (frame % FRAMES_PER_WORD)) & 1;
+}
+
+static void add_region(uint64_t base, uint64_t length, uint32_t type) {
+    if (region_count >= PMM_MAX_REGIONS || length == 0) return;
+    regions[region_count].base = base;
+    regions[region_count].length = length;
+    regions[region_count].type = type;
+    region_count++;
+}
+
+// Collect the memory map, falling back to mem_lower/mem_upper
+static void read_memory_map(multiboot_info_t* mbi) {
+    if (!mbi) return;
+    
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        uint32_t addr = mbi->mmap_addr;
+        uint32_t end = mbi->mmap_addr + mbi->mmap_length;
+        
+        while (addr < end) {
+            multiboot_mmap_entry_t* entry = (multiboot_mmap_entry_t*)addr;
+            add_region(entry->addr, entry->len, entry->type);
+            addr += entry->size + sizeof(entry->size);
+        }
+    } else if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+        add_region(0, (uint64_t)mbi->mem_lower * 1024, MULTIBOOT_MEMORY_AVAILABLE);
+        add_region(LOW_MEMORY_END, (uint64_t)mbi->mem_upper * 1024, MULTIBOOT_MEMORY_AVAILABLE);
+    }
+}
+
+static void add_boot_range(uint32_t base, uint32_t length) {
+    if (boot_range_count >= PMM_MAX_BOOT_RANGES || base == 0 || length == 0) return;
+    boot_ranges[boot_range_count].base = base;
+    boot_ranges[boot_range_count].length = length;
+    boot_range_count++;
+}
+
+static void add_boot_string(uint32_t address) {
+    if (address) add_boot_range(address, strlen((const char*)address) + 1);
+}
+
+// Everything the info block points to; later code (the framebuffer
+// console, module users) still reads it after the heap starts growing
+static void collect_boot_ranges(multiboot_info_t* mbi) {
+    add_boot_range((uint32_t)mbi, sizeof(multiboot_info_t));
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        add_boot_range(mbi->mmap_addr, mbi->mmap_length);
+    }
+    if (mbi->flags & MULTIBOOT_INFO_CMDLINE) {
+        add_boot_string(mbi->cmdline);
+    }
+    if (mbi->flags & MULTIBOOT_INFO_MODS) {
+        multiboot_module_t* modules = (multiboot_module_t*)mbi->mods_addr;
+        add_boot_range(mbi->mods_addr, mbi->mods_count * sizeof(multiboot_module_t));
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            if (modules[i].mod_end > modules[i].mod_start) {
+                add_boot_range(modules[i].mod_start, modules[i].mod_end - modules[i].mod_start);
+            }
+            add_boot_string(modules[i].string);
+        }
+    }
+    if (mbi->flags & MULTIBOOT_INFO_LOADER_NAME) {
+        add_boot_string(mbi->boot_loader_name);
+    }
+    if (mbi->flags & MULTIBOOT_INFO_VBE_INFO) {
+        add_boot_range(mbi->vbe_control_info, MULTIBOOT_VBE_CONTROL_INFO_SIZE);
+        add_boot_range(mbi->vbe_mode_info, MULTIBOOT_VBE_MODE_INFO_SIZE);
+    }
+}
+
+// First page boundary at or after `start` where `size` bytes overlap no
+// boot range. GRUB loads modules right after the kernel, so the bitmap
+// cannot simply go at kernel_end.
+static uint32_t place_bitmap(uint32_t start, uint32_t size) {
+    uint32_t address = (start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    int moved = 1;
+    while (moved) {
+        moved = 0;
+        for (int i = 0; i < boot_range_count; i++) {
+            uint32_t end = boot_ranges[i].base + boot_ranges[i].length;
+            if (address < end && boot_ranges[i].base < address + size) {
+                address = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+                moved = 1;
+            }
+        }
+    }
+    return address;
+}
+
+// Mark frames overlapping [base, base + length) as used or free
+static void mark_range(uint64_t base, uint64_t length, int used) {
+    uint64_t end = base + length;
+    uint64_t limit = (uint64_t)frame_count * PAGE_SIZE;
+    if (end > limit) end = limit;
+    
+    // Free only whole frames; reserve any frame that is touched
+    uint64_t first = used ? base / PAGE_SIZE : (base + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t last = used ? (end + PAGE_SIZE - 1) / PAGE_SIZE : end / PAGE_SIZE;
+    
+    for (uint64_t frame = first; frame < last; frame++) {
+        if (used && !frame_test((uint32_t)frame)) {
+            frame_set((uint32_t)frame);
+            free_frames--;
+        } else if (!used && frame_test((uint32_t)frame)) {
+            frame_clear((uint32_t)frame);
+            free_frames++;
+        }
+    }
+}
+
+// Initialize the frame allocator from the multiboot memory map
+void pmm_init(multiboot_info_t* mbi) {
+    read_memory_map(mbi);
+    
+    // Size the bitmap for the highest usable address below 4GB
+    uint64_t top = 0;
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].type != MULTIBOOT_MEMORY_AVAILABLE) continue;
+        
+        uint64_t end = regions[i].base + regions[i].length;
+        if (end > 0x100000000ULL) end = 0x100000000ULL;
+        if (end > regions[i].base) {
+            usable_bytes += (size_t)(end - regions[i].base);
+        }
+        if (end > top) top = end;
+    }
+    if (top == 0) return; // No map: the heap stays on its static pool
+    if (top > IDENTITY_MAP_LIMIT) top = IDENTITY_MAP_LIMIT; // Frames must be mapped
+    
+    frame_count = (uint32_t)(top / PAGE_SIZE);
+    uint32_t words = (frame_count + FRAMES_PER_WORD - 1) / FRAMES_PER_WORD;
+    
+    collect_boot_ranges(mbi);
+    uint32_t bitmap_addr = place_bitmap((uint32_t)kernel_end, words * sizeof(uint32_t));
+    frame_bitmap = (uint32_t*)bitmap_addr;
+    for (uint32_t i = 0; i < words; i++) {
+        frame_bitmap[i] = 0xFFFFFFFF;
+    }
+    free_frames = 0;
+    
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].type == MULTIBOOT_MEMORY_AVAILABLE) {
+            mark_range(regions[i].base, regions[i].length, 0);
+        }
+    }
+    
+    // Low memory, the kernel image, the boot loader's data and the bitmap
+    // itself are never handed out
+    mark_range(0, LOW_MEMORY_END, 1);
+    mark_range((uint32_t)kernel_start, (uint32_t)kernel_end - (uint32_t)kernel_start, 1);
+    mark_range(bitmap_addr, words * sizeof(uint32_t), 1);
+    for (int i = 0; i < boot_range_count; i++) {
+        mark_range(boot_ranges[i].base, boot_ranges[i].length, 1);
+    }
+}
+
+// Allocate one frame
+void* pmm_alloc_frame(void) {
+    if (!frame_bitmap || free_frames == 0) return NULL;
+    
+    uint32_t words = (frame_count + FRAMES_PER_WORD - 1) / FRAMES_PER_WORD;
+    for (uint32_t n = 0; n < words; n++) {
+        uint32_t word = (search_hint + n) % words;
+        if (frame_bitmap[word] == 0xFFFFFFFF) continue;
+        
+        uint32_t frame = word * FRAMES_PER_WORD + __builtin_ctz(~frame_bitmap[word]);
+        if (frame >= frame_count) continue;
+        
+        frame_set(frame);
+        free_frames--;
+        search_hint = word;
+        return (void*)(frame * PAGE_SIZE);
+    }
+    
+    return NULL;
+}
+
+// Allocate `count` physically contiguous frames (first fit)
+void* pmm_alloc_frames(size_t count) {
+    if (count == 1) return pmm_alloc_frame();
+    if (!frame_bitmap || count == 0 || count > free_frames) return NULL;
+    
+    uint32_t run = 0;
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        // Skip fully used words quickly
+        if (frame % FRAMES_PER_WORD == 0 && frame_bitmap[frame / FRAMES_PER_WORD] == 0xFFFFFFFF) {
+            run = 0;
+            frame += FRAMES_PER_WORD - 1;
+            continue;
+        }
+        
+        if (frame_test(frame)) {
+            run = 0;
+            continue;
+        }
+        
+        if (++run == count) {
+            uint32_t first = frame + 1 - run;
+            for (uint32_t f = first; f <= frame; f++) {
+                frame_set(f);
+            }
+            free_frames -= run;
+            return (void*)(first * PAGE_SIZE);
+        }
+    }
+    
+    return NULL;
+}
+
+// Free one frame
+void pmm_free_frame(void* frame) {
+    pmm_free_frames(frame, 1);
+}
+
+// Free `count` contiguous frames starting at `base`
+void pmm_free_frames(void* base, size_t count) {
+    uint32_t first = (uint32_t)base / PAGE_SIZE;
+    
+    if (!frame_bitmap || ((uint32_t)base & (PAGE_SIZE - 1)) || first + count > frame_count) {
+        shell_print_string("pmm_free_frames: Invalid frame!\n");
+        return;
+    }
+    
+    for (uint32_t frame = first; frame < first + count; frame++) {
+        if (!frame_test(frame)) {
+            shell_print_string("pmm_free_frames: Double free detected!\n");
+            continue;
+        }
+        frame_clear(frame);
+        free_frames++;
+    }
+}
+
+// Hand the kernel heap a run of contiguous frames covering at least *bytes
+void* pmm_heap_grow(size_t* bytes) {
+    size_t size = *bytes < PMM_HEAP_GROW_MIN ? PMM_HEAP_GROW_MIN : *bytes;
+    size = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    
+    void* region = pmm_alloc_frames(size / PAGE_SIZE);
+    if (!region && size > *bytes) {
+        // Fragmented: settle for exactly what was asked
+        size = (*bytes + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+        region = pmm_alloc_frames(size / PAGE_SIZE);
+    }
+    if (region) *bytes = size;
+    
+    return region;
+}
+
+// Usable RAM reported by the boot loader
+size_t pmm_get_total_memory(void) {
+    return usable_bytes;
+}
+
+// Free frames, in bytes
+size_t pmm_get_free_memory(void) {
+    return (size_t)free_frames * PAGE_SIZE;
+}
+
+// First address past the highest usable frame
+uint32_t pmm_get_memory_end(void) {
+    return frame_count * PAGE_SIZE;
+}
+
+// Debug: print the boot loader memory map
+void pmm_dump_map(void) {
+    static const char* type_names[] = {
+        "unknown", "usable", "reserved", "ACPI reclaimable", "ACPI NVS", "bad"
+    };
+    char buffer[16];
+    
+    if (region_count == 0) {
+        shell_print_string("No memory map from boot loader\n");
+        return;
+    }
+    
+    shell_print_string("Physical memory map:\n");
+    for (int i = 0; i < region_count; i++) {
+        uint32_t type = regions[i].type <= MULTIBOOT_MEMORY_BADRAM ? regions[i].type : 0;
+        
+        shell_print_string("  0x");
+        if (regions[i].base >> 32) {
+            itoa_hex((uint32_t)(regions[i].base >> 32), buffer);
+            shell_print_string(buffer);
+            // Zero-pad the low half
+            itoa_hex((uint32_t)regions[i].base, buffer);
+            for (int pad = my_strlen(buffer); pad < 8; pad++) {
+                shell_print_char('0');
+            }
+        } else {
+            itoa_hex((uint32_t)regions[i].base, buffer);
+        }
+        shell_print_string(buffer);
+        shell_print_string("  ");
+        itoa((uint32_t)(regions[i].length / 1024), buffer);
+        shell_print_string(buffer);
+        shell_print_string(" KB  ");
+        shell_print_string(type_names[type]);
+        shell_print_char('\n');
+    }
+    
+    shell_print_string("Frames: ");
+    itoa(free_frames, buffer);
+    shell_print_string(buffer);
+    shell_print_string(" free of ");
+    itoa(frame_count, buffer);
+    shell_print_string(buffer);
+    shell_print_string(" (4KB each)\n");
+}
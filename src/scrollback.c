@@ -0,0 +1,113 @@
+#include "scrollback.h"
+#include "string_utils.h"
+
+// Record layout: [text length][text][run count][(run length, attribute)...]
+// Runs cover the whole row, including the trimmed blanks.
+#define RECORD_MAX (1 + CONSOLE_MAX_COLS + 1 + 2 * CONSOLE_MAX_COLS)
+
+static void drop_oldest(scrollback_t* history) {
+    history->first_line++;
+    if (history->first_line == SCROLLBACK_LINES) history->first_line = 0;
+    history->line_count--;
+}
+
+// Make [write_pos, write_pos + length) free, wrapping to the start of the
+// store if the record does not fit before its end
+static void make_room(scrollback_t* history, unsigned int length) {
+    if (history->write_pos + length > SCROLLBACK_BYTES) {
+        // Records never wrap. Lines stored past the write position are the
+        // oldest and would be overwritten next anyway, so drop them and
+        // continue at the front of the store.
+        while (history->line_count > 0 &&
+               history->line_offset[history->first_line] >= history->write_pos) {
+            drop_oldest(history);
+        }
+        history->write_pos = 0;
+    }
+    
+    // Live data ahead of the write position is overwritten, oldest first
+    while (history->line_count > 0) {
+        unsigned int oldest = history->line_offset[history->first_line];
+        if (oldest < history->write_pos || oldest >= history->write_pos + length) break;
+        drop_oldest(history);
+    }
+    if (history->line_count == SCROLLBACK_LINES) drop_oldest(history);
+}
+
+void scrollback_push(scrollback_t* history, const VideoChar* row, int columns) {
+    unsigned char record[RECORD_MAX];
+    int text_length = columns;
+    
+    while (text_length > 0 && row[text_length - 1].character == ' ') {
+        text_length--;
+    }
+    
+    unsigned int length = 0;
+    record[length++] = text_length;
+    for (int i = 0; i < text_length; i++) {
+        record[length++] = row[i].character;
+    }
+    
+    unsigned int count_pos = length++;
+    int runs = 0;
+    for (int i = 0; i < columns; ) {
+        unsigned char attribute = row[i].attribute;
+        int start = i;
+        while (i < columns && row[i].attribute == attribute) i++;
+        record[length++] = i - start;
+        record[length++] = attribute;
+        runs++;
+    }
+    record[count_pos] = runs;
+    
+    make_room(history, length);
+    memcpy(history->store + history->write_pos, record, length);
+    
+    int slot = history->first_line + history->line_count;
+    if (slot >= SCROLLBACK_LINES) slot -= SCROLLBACK_LINES;
+    history->line_offset[slot] = history->write_pos;
+    history->line_count++;
+    history->write_pos += length;
+}
+
+int scrollback_count(const scrollback_t* history) {
+    return history->line_count;
+}
+
+int scrollback_get(const scrollback_t* history, int index, VideoChar* row, int columns) {
+    if (index < 0 || index >= history->line_count) return 0;
+    
+    int slot = history->first_line + index;
+    if (slot >= SCROLLBACK_LINES) slot -= SCROLLBACK_LINES;
+    const unsigned char* record = history->store + history->line_offset[slot];
+    
+    int text_length = *record++;
+    for (int i = 0; i < columns; i++) {
+        row[i].character = i < text_length ? (char)record[i] : ' ';
+    }
+    record += text_length;
+    
+    int runs = *record++;
+    int column = 0;
+    unsigned char attribute = (BLACK << 4) | WHITE;
+    for (int r = 0; r < runs; r++) {
+        int run_length = record[0];
+        attribute = record[1];
+        record += 2;
+        while (run_length-- > 0 && column < columns) {
+            row[column++].attribute = attribute;
+        }
+    }
+    
+    // Lines recorded on a narrower screen continue their last colour
+    while (column < columns) {
+        row[column++].attribute = attribute;
+    }
+    return 1;
+}
+
+void scrollback_clear(scrollback_t* history) {
+    history->first_line = 0;
+    history->line_count = 0;
+    history->write_pos = 0;
+}
@@ -0,0 +1,280 @@
+#include "serial.h"
+#include "interrupts.h"
+#include "io.h"
+#include "keyboard.h"
+#include "kprintf.h"
+#include "timer.h"
+
+// 16550 registers, relative to the base port
+#define UART_DATA 0                 // RBR/THR, divisor low with DLAB
+#define UART_IER 1                  // Interrupt enable, divisor high with DLAB
+#define UART_IIR 2                  // Interrupt identification (read)
+#define UART_FCR 2                  // FIFO control (write)
+#define UART_LCR 3
+#define UART_MCR 4
+#define UART_LSR 5
+#define UART_MSR 6
+
+#define IER_RX_AVAILABLE 0x01
+#define IER_TX_EMPTY 0x02
+#define LCR_8N1 0x03
+#define LCR_DLAB 0x80
+#define FCR_ENABLE_14 0xC7          // Enable and clear FIFOs, RX trigger at 14 bytes
+#define MCR_DTR_RTS_OUT2 0x0B       // OUT2 gates the IRQ line on PCs
+#define MCR_LOOPBACK 0x1E
+#define LSR_DATA_READY 0x01
+#define LSR_THR_EMPTY 0x20
+
+#define IIR_NONE 0x01
+#define IIR_MODEM 0x00
+#define IIR_TX_EMPTY 0x02
+#define IIR_RX_DATA 0x04
+#define IIR_LINE_STATUS 0x06
+#define IIR_RX_TIMEOUT 0x0C
+
+#define ESCAPE_WAIT_MS 50           // Time allowed for the rest of an escape sequence
+#define ESCAPE_WAIT_POLLS 100000    // The same, when no timer is running
+
+static int present = 0;
+static int fifo_depth = 1;
+
+// Transmit ring: filled by serial_put_char, drained by the interrupt
+// handler. Indices run freely and are masked on access.
+static volatile char tx_ring[SERIAL_TX_SIZE];
+static volatile unsigned int tx_head = 0;
+static volatile unsigned int tx_tail = 0;
+static volatile int tx_active = 0;  // Transmit interrupt armed
+
+// Receive ring: filled by the interrupt handler
+static volatile char rx_ring[SERIAL_RX_SIZE];
+static volatile unsigned int rx_head = 0;
+static volatile unsigned int rx_tail = 0;
+static volatile unsigned int rx_dropped = 0;
+
+static int pending_key = -1;        // Byte read ahead while parsing an escape
+static int last_was_cr = 0;
+
+static void uart_write(int reg, unsigned char value) {
+    outb(SERIAL_COM1 + reg, value);
+}
+
+static unsigned char uart_read(int reg) {
+    return inb(SERIAL_COM1 + reg);
+}
+
+// Move queued bytes into the transmit FIFO, which is empty when called
+static void fill_fifo(void) {
+    for (int i = 0; i < fifo_depth && tx_head != tx_tail; i++) {
+        uart_write(UART_DATA, tx_ring[tx_head & (SERIAL_TX_SIZE - 1)]);
+        tx_head++;
+    }
+}
+
+static void serial_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    unsigned char iir;
+    
+    while (!((iir = uart_read(UART_IIR)) & IIR_NONE)) {
+        switch (iir & 0x0E) {
+            case IIR_RX_DATA:
+            case IIR_RX_TIMEOUT:
+                while (uart_read(UART_LSR) & LSR_DATA_READY) {
+                    char c = uart_read(UART_DATA);
+                    if (rx_tail - rx_head < SERIAL_RX_SIZE) {
+                        rx_ring[rx_tail & (SERIAL_RX_SIZE - 1)] = c;
+                        rx_tail++;
+                    } else {
+                        rx_dropped++;
+                    }
+                }
+                break;
+            case IIR_TX_EMPTY:
+                if (tx_head == tx_tail) {
+                    tx_active = 0;
+                    uart_write(UART_IER, IER_RX_AVAILABLE);
+                } else {
+                    fill_fifo();
+                }
+                break;
+            case IIR_LINE_STATUS:
+                uart_read(UART_LSR);
+                break;
+            case IIR_MODEM:
+                uart_read(UART_MSR);
+                break;
+        }
+    }
+}
+
+int serial_init(void) {
+    uart_write(UART_IER, 0);
+    uart_write(UART_LCR, LCR_DLAB);
+    uart_write(UART_DATA, 1);       // Divisor 1: 115200 baud
+    uart_write(UART_IER, 0);
+    uart_write(UART_LCR, LCR_8N1);
+    uart_write(UART_FCR, FCR_ENABLE_14);
+    
+    // Check that a UART answers by looping a byte back to ourselves
+    uart_write(UART_MCR, MCR_LOOPBACK);
+    uart_write(UART_DATA, 0xAE);
+    if (uart_read(UART_DATA) != 0xAE) return 0;
+    uart_write(UART_MCR, MCR_DTR_RTS_OUT2);
+    
+    // Both FIFO bits set means a working 16550A; older parts send one byte
+    // per interrupt
+    fifo_depth = (uart_read(UART_IIR) & 0xC0) == 0xC0 ? 16 : 1;
+    
+    if (!irq_register(SERIAL_IRQ, serial_irq)) return 0;
+    uart_write(UART_IER, IER_RX_AVAILABLE);
+    present = 1;
+    return 1;
+}
+
+int serial_present(void) {
+    return present;
+}
+
+// Arm the transmit interrupt if it is idle. The check and the arming must
+// not be split by the handler disarming it, hence interrupts off.
+static void start_transmit(void) {
+    if (tx_active) return;
+    
+    uint32_t flags = irq_save();
+    if (!tx_active && tx_head != tx_tail) {
+        tx_active = 1;
+        uart_write(UART_IER, IER_RX_AVAILABLE | IER_TX_EMPTY);
+    }
+    irq_restore(flags);
+}
+
+static void queue_byte(char c) {
+    while (tx_tail - tx_head >= SERIAL_TX_SIZE) {
+        if (interrupts_enabled()) {
+            start_transmit();
+            cpu_idle();             // The transmit interrupt wakes us
+        } else {
+            // No interrupt will drain the ring, so send the oldest byte here
+            while (!(uart_read(UART_LSR) & LSR_THR_EMPTY));
+            uart_write(UART_DATA, tx_ring[tx_head & (SERIAL_TX_SIZE - 1)]);
+            tx_head++;
+        }
+    }
+    tx_ring[tx_tail & (SERIAL_TX_SIZE - 1)] = c;
+    __asm__ volatile ("" : : : "memory");
+    tx_tail++;
+}
+
+void serial_put_char(char c) {
+    if (!present) return;
+    
+    if (c == '\n') {
+        queue_byte('\r');
+        queue_byte('\n');
+    } else if (c == '\b') {
+        queue_byte('\b');
+        queue_byte(' ');
+        queue_byte('\b');
+    } else {
+        queue_byte(c);
+    }
+    start_transmit();
+}
+
+void serial_write(const char* str, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        serial_put_char(str[i]);
+    }
+}
+
+static int rx_pop(void) {
+    if (pending_key >= 0) {
+        int c = pending_key;
+        pending_key = -1;
+        return c;
+    }
+    if (rx_head == rx_tail) return -1;
+    
+    unsigned char c = rx_ring[rx_head & (SERIAL_RX_SIZE - 1)];
+    __asm__ volatile ("" : : : "memory");
+    rx_head++;
+    return c;
+}
+
+// Terminals send an escape sequence in one burst, so its remaining bytes
+// are at most a few character times behind the ESC. With the timer
+// running, sleep between receive interrupts until the deadline.
+static int rx_wait(void) {
+    if (timer_frequency() && interrupts_enabled()) {
+        uint64_t deadline = timer_uptime_ms() + ESCAPE_WAIT_MS;
+        while (timer_uptime_ms() < deadline) {
+            int c = rx_pop();
+            if (c >= 0) return c;
+            cpu_idle();
+        }
+        return rx_pop();
+    }
+    
+    for (int i = 0; i < ESCAPE_WAIT_POLLS; i++) {
+        int c = rx_pop();
+        if (c >= 0) return c;
+        __asm__ volatile ("pause");
+    }
+    return -1;
+}
+
+// Decode the rest of ESC [ or ESC O: optional number, then a final byte
+static int read_escape(void) {
+    int number = 0;
+    int c;
+    
+    while ((c = rx_wait()) >= '0' && c <= '9') {
+        number = number * 10 + (c - '0');
+    }
+    switch (c) {
+        case 'A': return ARROW_UP;
+        case 'B': return ARROW_DOWN;
+        case 'C': return ARROW_RIGHT;
+        case 'D': return ARROW_LEFT;
+        case 'H': return KEY_HOME_CODE;
+        case 'F': return KEY_END_CODE;
+        case '~':
+            if (number == 1 || number == 7) return KEY_HOME_CODE;
+            if (number == 4 || number == 8) return KEY_END_CODE;
+            if (number == 3) return KEY_DEL_CODE;
+            break;
+    }
+    return -1;
+}
+
+int serial_read_key(void) {
+    int c = rx_pop();
+    if (c < 0) return -1;
+    
+    // Accept CR, LF or CR LF as one Enter
+    if (c == '\n' && last_was_cr) {
+        last_was_cr = 0;
+        c = rx_pop();
+        if (c < 0) return -1;
+    }
+    last_was_cr = (c == '\r');
+    
+    if (c == '\r' || c == '\n') return '\n';
+    if (c == 0x7F) return '\b';
+    if (c != 0x1B) return c;
+    
+    int next = rx_wait();
+    if (next == '[' || next == 'O') return read_escape();
+    pending_key = next;
+    return KEY_ESC_CODE;
+}
+
+void serial_dump_info(void) {
+    if (!present) {
+        kprintf("Serial: no UART at COM1\n");
+        return;
+    }
+    kprintf("Serial: COM1 115200 8N1, %s, IRQ %d\n",
+            fifo_depth > 1 ? "16550A FIFO" : "no FIFO", SERIAL_IRQ);
+    kprintf("Serial queues: %u bytes to send, %u received, %u dropped\n",
+            tx_tail - tx_head, rx_tail - rx_head, rx_dropped);
+}
@@ -4,6 +4,8 @@
 #include "io.h"
 #include "string_utils.h"
 #include "filesystem.h"
+#include "arena.h"
+#include "kprintf.h"
 #include <string.h>
 
 void shutdown() {
@@ -32,18 +34,24 @@ void print_with_pagination(const char* text) {
     int lines = 0;
     const char* ptr = text;
     
+    // Draw a line at a time so each one reaches the screen in a single flush
     while (*ptr) {
-        shell_print_char(*ptr);
-        if (*ptr == '\n') {
-            lines++;
-            if (lines >= 20) {
-                shell_print_colored("\n--- Press any key to continue ---", COLOR_PROMPT, BLACK);
-                get_char();
-                shell_print_string("\n");
-                lines = 0;
-            }
+        const char* newline = strchr(ptr, '\n');
+        if (!newline) {
+            shell_print_string(ptr);
+            break;
+        }
+        shell_print_buffer(ptr, newline - ptr + 1);
+        ptr = newline + 1;
+        
+        lines++;
+        if (lines >= 20) {
+            // The prompt is erased again so it never lands in the scrollback
+            shell_print_colored("--- Press any key to continue (Shift+PgUp to look back) ---", COLOR_PROMPT, BLACK);
+            get_char();
+            display_clear_line();
+            lines = 0;
         }
-        ptr++;
     }
 }
 
@@ -62,12 +70,18 @@ void show_quick_help() {
     shell_print_string("  clear        - Clear screen\n");
     shell_print_string("  fastfetch    - Stylized system info\n");
     shell_print_string("  memory       - Memory management and info\n");
+    shell_print_string("  time <cmd>   - Measure how long a command takes\n");
+    shell_print_string("  ps           - List kernel threads\n");
+    shell_print_string("  <cmd> &      - Run a command in the background\n");
+    shell_print_string("  jobs, fg, wait - Manage background jobs\n");
     shell_print_string("  color <f> <b> - Set colors (0-15)\n");
     shell_print_string("  shutdown     - Shutdown system\n\n");
     shell_print_string(" FAT32 Filesystem:\n");
     shell_print_string("  fat32 init   - Initialize FAT32\n");
     shell_print_string("  fat32 ls     - List FAT32 files\n\n");
     shell_print_string(" Tips: Use Tab for completion, arrows for history\n");
+    shell_print_string("       Shift+PgUp/PgDn scroll back through earlier output\n");
+    shell_print_string("       Alt+F1..F4 switch virtual terminals\n");
     shell_print_string(" For detailed help: help <command>\n");
     shell_print_string("For full documentation: help --full\n\n");
 }
@@ -100,6 +114,12 @@ void show_full_help() {
         "  hardware         - Show hardware detection information\n"
         "  memory           - Memory management and statistics\n"
         "  debug            - Display debug info & filesystem stats\n"
+        "  time <command>   - Run a command and report elapsed ns and cycles\n"
+        "  ps               - List kernel threads and their CPU time\n"
+        "  <command> &      - Run a command as a background job\n"
+        "  jobs             - List background jobs\n"
+        "  fg [%n]          - Show a job's output and wait for it\n"
+        "  wait [%n]        - Wait for one job, or all of them\n"
         "  shutdown         - Safely shutdown the system\n\n"
         "FAT32 FILESYSTEM:\n"
         "  fat32 init       - Initialize FAT32 filesystem on disk\n"
@@ -159,13 +179,16 @@ void show_command_help(const char* command) {
     else if (strcmp(command, "shutdown") == 0) show_shutdown_help();
     else if (strcmp(command, "clear") == 0) show_clear_help();
     else if (strcmp(command, "memory") == 0) show_memory_help();
+    else if (strcmp(command, "time") == 0) show_time_help();
+    else if (strcmp(command, "ps") == 0) show_ps_help();
+    else if (strcmp(command, "jobs") == 0 || strcmp(command, "fg") == 0 || strcmp(command, "wait") == 0) show_jobs_help();
     else {
         shell_print_colored("\nUnknown command: ", COLOR_ERROR, BLACK);
         shell_print_colored(command, COLOR_WARNING, BLACK);
         shell_print_string("\n\nAvailable commands:\n");
         shell_print_string("  ls, cd, pwd, mkdir, touch, cat, rm, chmod\n");
     shell_print_string("  write, clear, fastfetch, color\n");
-        shell_print_string("  memory, fat32, debug, shutdown\n\n");
+        shell_print_string("  memory, fat32, debug, time, ps, jobs, fg, wait, shutdown\n\n");
         shell_print_string("Use 'help' for quick reference or 'help --full' for complete documentation.\n\n");
     }
 }
@@ -408,6 +431,36 @@ void show_fastfetch_help() {
     shell_print_string("  stylized format similar to neofetch.\n\n");
 }
 
+void show_time_help() {
+    shell_print_colored("\n=== time - Measure a Command ===\n", COLOR_INFO, BLACK);
+    shell_print_string("Usage: time <command> [arguments]\n\n");
+    shell_print_string("Description:\n");
+    shell_print_string("  Runs the command and prints the elapsed time in nanoseconds\n");
+    shell_print_string("  and TSC cycles, e.g. 'time ls' or 'time fat32 init'.\n\n");
+}
+
+void show_ps_help() {
+    shell_print_colored("\n=== ps - List Threads ===\n", COLOR_INFO, BLACK);
+    shell_print_string("Usage: ps\n\n");
+    shell_print_string("Description:\n");
+    shell_print_string("  Shows every kernel thread with its ID, priority, state\n");
+    shell_print_string("  and the CPU time it has used.\n\n");
+}
+
+void show_jobs_help() {
+    shell_print_colored("\n=== Background Jobs ===\n", COLOR_INFO, BLACK);
+    shell_print_string("Usage: <command> &\n");
+    shell_print_string("       jobs\n");
+    shell_print_string("       fg [%n]\n");
+    shell_print_string("       wait [%n]\n\n");
+    shell_print_string("Description:\n");
+    shell_print_string("  A trailing '&' runs the command in its own thread. Its output\n");
+    shell_print_string("  is buffered and shown when the job finishes, before the next\n");
+    shell_print_string("  prompt. 'fg' shows the output so far and waits for the job;\n");
+    shell_print_string("  'wait' waits for one job or, without a number, for all.\n");
+    shell_print_string("  A job that reads the keyboard stops until 'fg'.\n\n");
+}
+
 void show_hardware_help() {
     shell_print_colored("\n=== hardware - Hardware Detection ===\n", COLOR_INFO, BLACK);
     shell_print_string("Usage: hardware\n\n");
@@ -444,18 +497,44 @@ void show_memory_help() {
     shell_print_string("  (none)     - Show memory statistics\n");
     shell_print_string("  dump       - Dump memory blocks information\n");
     shell_print_string("  check      - Check memory integrity\n");
-    shell_print_string("  test       - Run allocation test\n\n");
+    shell_print_string("  test       - Run allocation test\n");
+    shell_print_string("  slabs      - Show slab object cache statistics\n");
+    shell_print_string("  stats      - Show heap counters and allocation sizes\n");
+    shell_print_string("  stats callers - Tag allocations, then list them by call site\n");
+    shell_print_string("  stats off  - Stop tagging allocations\n");
+    shell_print_string("  map        - Show the physical memory map and paging mode\n\n");
     shell_print_string("Examples:\n");
     shell_print_string("  memory     - Show total/used/free memory\n");
     shell_print_string("  memory dump - Show detailed block information\n");
     shell_print_string("  memory check - Verify memory structure integrity\n");
-    shell_print_string("  memory test  - Test allocation/deallocation\n\n");
+    shell_print_string("  memory test  - Test allocation/deallocation\n");
+    shell_print_string("  memory slabs - List object caches and their usage\n");
+    shell_print_string("  memory stats - Peak usage, counts and a size histogram\n");
+    shell_print_string("  memory map   - List RAM regions reported by the boot loader\n\n");
     shell_print_string("Description:\n");
-    shell_print_string("Manages system memory with simple malloc/free implementation.\n");
+    shell_print_string("Manages system memory with an O(1) segregated-fit allocator.\n");
+    shell_print_string("The heap grows into all usable RAM via the page-frame allocator.\n");
     shell_print_string("Provides memory statistics and debugging capabilities.\n\n");
     shell_print_string("Tip: Use 'memory check' if experiencing memory issues\n\n");
 }
 
+// Print "oszoOS <path> > " in the prompt colours, as one string
+void shell_print_prompt(const char* path) {
+    kprintf(ANSI_SUCCESS "oszoOS " ANSI_DIR "%s" ANSI_WARNING " > " ANSI_RESET, path);
+}
+
+// Rewrite the line from `from` to its end, erase what is left of the old
+// text and step back to `cursor_pos`, all in one write
+static void redraw_tail(const char* buffer, int from, int index, int cursor_pos) {
+    char out[KPRINTF_BUFFER_SIZE];
+    int length = ksnprintf(out, sizeof(out), "%.*s\033[K", index - from, buffer + from);
+    if (index > cursor_pos && length < (int)sizeof(out)) {
+        length += ksnprintf(out + length, sizeof(out) - length, "\033[%dD", index - cursor_pos);
+    }
+    if (length >= (int)sizeof(out)) length = sizeof(out) - 1;
+    shell_print_buffer(out, length);
+}
+
 void readline(char* buffer, int max_len) {
     int index = 0;
     int cursor_pos = 0;
@@ -463,6 +542,11 @@ void readline(char* buffer, int max_len) {
     while (1) {
         int key = get_char();
         if (key == 0) continue;
+        if (key == KEY_VT_SWITCH) {
+            // Start over with a fresh prompt on the terminal now shown
+            buffer[0] = '\0';
+            return;
+        }
         if (key >= F1_CODE && key <= F12_CODE) {
             switch (key) {
                 case F1_CODE:
@@ -510,9 +594,7 @@ void readline(char* buffer, int max_len) {
                 cursor_pos--;
                 buffer[index] = '\0';
                 shell_print_char(0x08);
-                for (int i = cursor_pos; i < index; i++) shell_print_char(buffer[i]);
-                shell_print_char(' ');
-                for (int i = 0; i <= index - cursor_pos; i++) shell_print_char(0x08);
+                redraw_tail(buffer, cursor_pos, index, cursor_pos);
             }
         } else if (key == KEY_DEL_CODE) { 
             if (cursor_pos < index) {
@@ -521,14 +603,12 @@ void readline(char* buffer, int max_len) {
                 }
                 index--;
                 buffer[index] = '\0';
-                for (int i = cursor_pos; i < index; i++) shell_print_char(buffer[i]);
-                shell_print_char(' ');
-                for (int i = 0; i <= index - cursor_pos; i++) shell_print_char(0x08);
+                redraw_tail(buffer, cursor_pos, index, cursor_pos);
             }
         } else if (key == ARROW_LEFT) {
             if (cursor_pos > 0) {
                 cursor_pos--;
-                shell_print_char(0x08); 
+                shell_print_string("\033[D");
             }
         } else if (key == ARROW_RIGHT) {
             if (cursor_pos < index) {
@@ -536,14 +616,14 @@ void readline(char* buffer, int max_len) {
                 shell_print_char(buffer[cursor_pos - 1]); 
             }
         } else if (key == KEY_HOME_CODE) { 
-            while (cursor_pos > 0) {
-                cursor_pos--;
-                shell_print_char(0x08);
+            if (cursor_pos > 0) {
+                kprintf("\033[%dD", cursor_pos);
+                cursor_pos = 0;
             }
         } else if (key == KEY_END_CODE) { 
-            while (cursor_pos < index) {
-                shell_print_char(buffer[cursor_pos]);
-                cursor_pos++;
+            if (cursor_pos < index) {
+                kprintf("\033[%dC", index - cursor_pos);
+                cursor_pos = index;
             }
         } else if (key == '\t') { 
             buffer[index] = '\0';
@@ -557,11 +637,14 @@ void readline(char* buffer, int max_len) {
                 prefix[prefix_len++] = buffer[i];
             }
             prefix[prefix_len] = '\0';
-            char matches[128][128]; 
+            // Candidates live in the scratch arena for the duration of the completion
+            arena_t* scratch = scratch_arena();
+            arena_mark_t mark = arena_mark(scratch);
+            char (*matches)[128] = (char (*)[128])arena_alloc(scratch, 128 * 128);
             int match_count = 0;
-            if (word_start == 0) {
+            if (matches && word_start == 0) {
                 match_count = find_matching_commands(prefix, matches, 128);
-            } else {
+            } else if (matches) {
                 match_count = find_matching_files(prefix, matches, 128, 0); 
             }
             if (match_count == 1) {
@@ -599,32 +682,28 @@ void readline(char* buffer, int max_len) {
                         shell_print_string("  ");
                     }
                     shell_print_char('\n');
-                    char current_path[256];
-                    get_current_path(current_path);
-                    shell_print_colored("oszoOS", COLOR_SUCCESS, BLACK);
-                    shell_print_colored(" ", WHITE, BLACK);
-                    shell_print_colored(current_path, COLOR_DIR, BLACK);
-                    shell_print_colored(" > ", COLOR_WARNING, BLACK);
-                    set_color(WHITE, BLACK);
-                    for (int i = 0; i < index; i++) {
-                        shell_print_char(buffer[i]);
+                    char* current_path = (char*)arena_alloc(scratch, MAX_PATH_LENGTH);
+                    if (current_path) {
+                        get_current_path(current_path);
                     }
+                    shell_print_prompt(current_path ? current_path : "");
+                    shell_print_buffer(buffer, index);
                 }
             }
+            arena_release(scratch, mark);
         } else if (index < max_len - 1 && key >= 32 && key <= 126) {
             for (int i = index; i > cursor_pos; i--) buffer[i] = buffer[i-1];
             buffer[cursor_pos] = key;
             index++;
             cursor_pos++;
-            for (int i = cursor_pos-1; i < index; i++) shell_print_char(buffer[i]);
-            for (int i = 0; i < index - cursor_pos; i++) shell_print_char(0x08);
+            redraw_tail(buffer, cursor_pos - 1, index, cursor_pos);
         }
     }
 }
 
 // Helper function to find matching commands
 int find_matching_commands(const char* prefix, char matches[][128], int max_matches) {
-    const char* commands[] = {"help", "ls", "cd", "cat", "write", "mkdir", "rm", "clear", "pwd", "edit", "fastfetch", "info", "reboot", "shutdown", "version"};
+    const char* commands[] = {"help", "ls", "cd", "cat", "write", "mkdir", "rm", "clear", "pwd", "edit", "fastfetch", "info", "reboot", "shutdown", "version", "time", "ps", "jobs", "fg", "wait"};
     int count = sizeof(commands) / sizeof(commands[0]);
     int match_count = 0;
     
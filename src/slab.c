@@ -0,0 +1,291 @@
+#include "slab.h"
+#include "memory.h"
+#include "display.h"
+#include "string_utils.h"
+
+#define DUMP_BATCH 16                   // Caches kmem_cache_dump_stats() copies per lock
+
+// All live caches, for statistics
+static kmem_cache_t* cache_chain = NULL;
+static spinlock_t chain_lock;
+
+// List helpers
+static void slab_list_add(slab_t** list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_list_remove(slab_t** list, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+static size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+// Usable bytes of a slab. The heap header of the next chunk sits in the
+// last bytes of each aligned window, so back-to-back slabs pack exactly.
+static size_t slab_usable_size(size_t slab_size) {
+    return slab_size - sizeof(memory_block_t);
+}
+
+// Allocate a fresh slab from the heap and thread its objects on the free list
+static slab_t* slab_grow(kmem_cache_t* cache) {
+    slab_t* slab = (slab_t*)malloc_aligned(slab_usable_size(cache->slab_size), cache->slab_size);
+    if (!slab) return NULL;
+    
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free_objects = NULL;
+    
+    // Thread in reverse so objects are handed out in address order
+    unsigned char* base = (unsigned char*)slab + cache->first_offset;
+    for (int i = (int)cache->objects_per_slab - 1; i >= 0; i--) {
+        void** obj = (void**)(base + i * cache->stride);
+        *obj = slab->free_objects;
+        slab->free_objects = obj;
+    }
+    
+    cache->slab_count++;
+    return slab;
+}
+
+static void slab_release(kmem_cache_t* cache, slab_t* slab) {
+    cache->slab_count--;
+    free(slab);
+}
+
+// Create a cache of `size`-byte objects. An `align` of 0 picks the cache
+// line for large objects and the next power of two for small ones, so no
+// object straddles more cache lines than it has to.
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void* obj)) {
+    if (size == 0) return NULL;
+    
+    if (align == 0) {
+        align = sizeof(void*);
+        while (align < size && align < CACHE_LINE_SIZE) align <<= 1;
+    }
+    if (align < sizeof(void*) || (align & (align - 1))) return NULL;
+    
+    kmem_cache_t* cache = (kmem_cache_t*)malloc(sizeof(kmem_cache_t));
+    if (!cache) return NULL;
+    
+    SAFE_STRCPY(cache->name, name ? name : "unnamed", KMEM_CACHE_NAME_LEN);
+    cache->object_size = size;
+    cache->align = align;
+    cache->stride = align_up(size < sizeof(void*) ? sizeof(void*) : size, align);
+    cache->first_offset = align_up(sizeof(slab_t), align);
+    cache->ctor = ctor;
+    
+    // Grow the slab until it holds a reasonable number of objects
+    cache->slab_size = SLAB_SIZE;
+    while ((slab_usable_size(cache->slab_size) - cache->first_offset) / cache->stride < SLAB_MIN_OBJECTS) {
+        cache->slab_size <<= 1;
+    }
+    cache->objects_per_slab = (slab_usable_size(cache->slab_size) - cache->first_offset) / cache->stride;
+    
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->slab_count = 0;
+    cache->active_objects = 0;
+    cache->alloc_count = 0;
+    cache->free_count = 0;
+    cache->lock.locked = 0;
+    
+    uint32_t flags = spin_lock_irqsave(&chain_lock);
+    cache->next = cache_chain;
+    cache_chain = cache;
+    spin_unlock_irqrestore(&chain_lock, flags);
+    
+    return cache;
+}
+
+// Release every slab and the cache itself. No object may be in use.
+void kmem_cache_destroy(kmem_cache_t* cache) {
+    if (!cache) return;
+    
+    uint32_t flags = spin_lock_irqsave(&chain_lock);
+    kmem_cache_t** link = &cache_chain;
+    while (*link && *link != cache) link = &(*link)->next;
+    if (*link) *link = cache->next;
+    spin_unlock_irqrestore(&chain_lock, flags);
+    
+    slab_t** lists[3] = {&cache->partial, &cache->full, &cache->empty};
+    for (int i = 0; i < 3; i++) {
+        while (*lists[i]) {
+            slab_t* slab = *lists[i];
+            slab_list_remove(lists[i], slab);
+            slab_release(cache, slab);
+        }
+    }
+    
+    free(cache);
+}
+
+// Return all empty slabs to the heap
+void kmem_cache_shrink(kmem_cache_t* cache) {
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    while (cache->empty) {
+        slab_t* slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_release(cache, slab);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+// Allocate one object
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    slab_t* slab = cache->partial;
+    
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_grow(cache);
+            if (!slab) {
+                spin_unlock_irqrestore(&cache->lock, flags);
+                return NULL;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+    
+    void** obj = (void**)slab->free_objects;
+    slab->free_objects = *obj;
+    slab->in_use++;
+    
+    if (slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+    
+    cache->active_objects++;
+    cache->alloc_count++;
+    spin_unlock_irqrestore(&cache->lock, flags);
+    
+    if (cache->ctor) {
+        cache->ctor(obj);
+    }
+    
+    return obj;
+}
+
+// Free one object back to its slab
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!obj) return;
+    
+    slab_t* slab = (slab_t*)((size_t)obj & ~(cache->slab_size - 1));
+    if (slab->cache != cache) {
+        shell_print_string("kmem_cache_free: Object not from cache ");
+        shell_print_string(cache->name);
+        shell_print_string("!\n");
+        return;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    int was_full = slab->in_use == cache->objects_per_slab;
+    
+    *(void**)obj = slab->free_objects;
+    slab->free_objects = obj;
+    slab->in_use--;
+    
+    if (was_full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+    
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        // Keep one empty slab around to avoid thrashing at a slab boundary
+        if (cache->empty) {
+            slab_release(cache, slab);
+        } else {
+            slab_list_add(&cache->empty, slab);
+        }
+    }
+    
+    cache->active_objects--;
+    cache->free_count++;
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+typedef struct {
+    char name[KMEM_CACHE_NAME_LEN];
+    unsigned int values[6];
+} cache_stats_t;
+
+// Copy the statistics of up to DUMP_BATCH caches, from cache number `first`
+static int stats_batch(int first, cache_stats_t* batch) {
+    int count = 0;
+    uint32_t flags = spin_lock_irqsave(&chain_lock);
+    for (kmem_cache_t* cache = cache_chain; cache && count < DUMP_BATCH; cache = cache->next) {
+        if (first) {
+            first--;
+            continue;
+        }
+        uint32_t cache_flags = spin_lock_irqsave(&cache->lock);
+        SAFE_STRCPY(batch[count].name, cache->name, KMEM_CACHE_NAME_LEN);
+        batch[count].values[0] = cache->stride;
+        batch[count].values[1] = cache->objects_per_slab;
+        batch[count].values[2] = cache->slab_count;
+        batch[count].values[3] = cache->active_objects;
+        batch[count].values[4] = cache->alloc_count;
+        batch[count].values[5] = cache->free_count;
+        spin_unlock_irqrestore(&cache->lock, cache_flags);
+        count++;
+    }
+    spin_unlock_irqrestore(&chain_lock, flags);
+    return count;
+}
+
+// Debug: print per-cache statistics, copied out under the locks
+void kmem_cache_dump_stats(void) {
+    cache_stats_t batch[DUMP_BATCH];
+    char buffer[16];
+    int shown = 0;
+    
+    for (;;) {
+        int count = stats_batch(shown, batch);
+        if (!count && !shown) {
+            shell_print_string("No slab caches\n");
+            return;
+        }
+        if (!shown) {
+            shell_print_colored("Cache               Size  Objs/Slab  Slabs  Active  Allocs  Frees\n", COLOR_INFO, BLACK);
+        }
+        
+        for (int n = 0; n < count; n++) {
+            int widths[6] = {6, 11, 7, 8, 8, 7};
+            
+            shell_print_string(batch[n].name);
+            for (int pad = my_strlen(batch[n].name); pad < KMEM_CACHE_NAME_LEN - 6; pad++) {
+                shell_print_char(' ');
+            }
+            
+            for (int i = 0; i < 6; i++) {
+                itoa(batch[n].values[i], buffer);
+                for (int pad = my_strlen(buffer); pad < widths[i]; pad++) {
+                    shell_print_char(' ');
+                }
+                shell_print_string(buffer);
+            }
+            shell_print_char('\n');
+        }
+        shown += count;
+        if (count < DUMP_BATCH) break;
+    }
+}
@@ -0,0 +1,196 @@
+#include "smp.h"
+#include "acpi.h"
+#include "apic.h"
+#include "paging.h"
+#include "memory.h"
+#include "timer.h"
+#include "kprintf.h"
+#include "display.h"
+
+// Where the real-mode entry code is copied; must match TRAMPOLINE_BASE in
+// ap_trampoline.asm. The low megabyte is never handed out by the PMM.
+#define AP_TRAMPOLINE_ADDRESS 0x8000
+#define AP_START_TIMEOUT_MS 100
+
+// Parameter block at the end of the trampoline
+typedef struct {
+    uint32_t cr0;
+    uint32_t cr3;
+    uint32_t cr4;
+    uint32_t stack;
+    uint32_t entry;
+    uint32_t cpu;
+} ap_params_t;
+
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_params[];
+
+static cpu_t cpus[SMP_MAX_CPUS];
+static int cpu_count = 1;
+static uint8_t apic_to_cpu[256];        // APIC ID -> index; unknown IDs map to 0
+static acpi_madt_info_t madt;
+static int have_madt = 0;
+
+// Wait for work in the mailbox, halted in between. The check runs with
+// interrupts off and sti;hlt opens them only once the CPU is halting, so
+// the wakeup IPI cannot slip in between the two.
+static void ap_idle(cpu_t* cpu) {
+    for (;;) {
+        __asm__ volatile ("cli");
+        smp_work_t work = __atomic_load_n(&cpu->work, __ATOMIC_ACQUIRE);
+        if (!work) {
+            __asm__ volatile ("sti\n hlt" : : : "memory");
+            continue;
+        }
+        
+        __asm__ volatile ("sti");
+        work(cpu->work_arg);
+        cpu->work_done++;
+        __atomic_store_n(&cpu->work, (smp_work_t)0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cpu->mailbox_busy, 0, __ATOMIC_RELEASE);
+    }
+}
+
+// First C code on an application processor, called by the trampoline
+static void ap_main(cpu_t* cpu) {
+    interrupts_init_cpu(&cpu->descriptors, (uint32_t)cpu->stack + AP_STACK_SIZE);
+    paging_init_cpu();
+    lapic_enable();
+    __asm__ volatile ("fninit");
+    
+    __atomic_store_n(&cpu->online, 1, __ATOMIC_RELEASE);
+    ap_idle(cpu);
+}
+
+static int wait_online(cpu_t* cpu, uint32_t ms) {
+    for (uint32_t i = 0; i < ms * 10 && !__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE); i++) {
+        ksleep_us(100);
+    }
+    return cpu->online;
+}
+
+// INIT, then up to two startup IPIs as in the MultiProcessor Specification
+static int start_ap(cpu_t* cpu) {
+    ap_params_t* params = (ap_params_t*)(AP_TRAMPOLINE_ADDRESS + (ap_trampoline_params - ap_trampoline_start));
+    params->stack = (uint32_t)cpu->stack + AP_STACK_SIZE;
+    params->entry = (uint32_t)ap_main;
+    params->cpu = (uint32_t)cpu;
+    __asm__ volatile ("" : : : "memory");
+    
+    lapic_send_init(cpu->apic_id);
+    ksleep_ms(10);
+    lapic_send_startup(cpu->apic_id, AP_TRAMPOLINE_ADDRESS);
+    if (wait_online(cpu, 1)) return 1;
+    lapic_send_startup(cpu->apic_id, AP_TRAMPOLINE_ADDRESS);
+    return wait_online(cpu, AP_START_TIMEOUT_MS);
+}
+
+int smp_init(void) {
+    cpu_t* boot = &cpus[0];
+    boot->index = 0;
+    boot->online = 1;
+    
+    if (!acpi_init() || !acpi_read_madt(&madt)) return cpu_count;
+    have_madt = 1;
+    if (!lapic_init(madt.lapic_address)) return cpu_count;
+    boot->apic_id = lapic_id();
+    
+    // The trampoline copy and its parameters; the control registers give
+    // the APs the same paging and FPU setup as this processor
+    uint32_t size = ap_trampoline_end - ap_trampoline_start;
+    uint8_t* trampoline = (uint8_t*)AP_TRAMPOLINE_ADDRESS;
+    for (uint32_t i = 0; i < size; i++) trampoline[i] = ap_trampoline_start[i];
+    
+    ap_params_t* params = (ap_params_t*)(trampoline + (ap_trampoline_params - ap_trampoline_start));
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(params->cr0));
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(params->cr3));
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(params->cr4));
+    
+    for (int i = 0; i < madt.cpu_count && cpu_count < SMP_MAX_CPUS; i++) {
+        if (madt.apic_ids[i] == boot->apic_id) continue;
+        
+        cpu_t* cpu = &cpus[cpu_count];
+        cpu->index = cpu_count;
+        cpu->apic_id = madt.apic_ids[i];
+        cpu->stack = malloc_aligned(AP_STACK_SIZE, 16);
+        if (!cpu->stack) break;
+        
+        if (!start_ap(cpu)) {
+            kprintf_colored(COLOR_WARNING, BLACK, "[WARNING] CPU with APIC ID %u did not start\n", cpu->apic_id);
+            free(cpu->stack);
+            cpu->stack = 0;
+            continue;
+        }
+        apic_to_cpu[cpu->apic_id] = cpu_count;
+        cpu_count++;
+    }
+    return cpu_count;
+}
+
+int smp_cpu_count(void) {
+    return cpu_count;
+}
+
+cpu_t* smp_cpu(int index) {
+    if (index < 0 || index >= cpu_count) return 0;
+    return &cpus[index];
+}
+
+int smp_cpu_index(void) {
+    if (cpu_count == 1) return 0;
+    return apic_to_cpu[lapic_id()];
+}
+
+int smp_call(int index, smp_work_t work, void* arg) {
+    if (index <= 0 || index >= cpu_count || !work) return 0;
+    cpu_t* cpu = &cpus[index];
+    
+    int expected = 0;
+    while (!__atomic_compare_exchange_n(&cpu->mailbox_busy, &expected, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        expected = 0;
+        __asm__ volatile ("pause");
+    }
+    cpu->work_arg = arg;
+    __atomic_store_n(&cpu->work, work, __ATOMIC_RELEASE);
+    lapic_send_ipi(cpu->apic_id, IPI_WAKEUP_VECTOR);
+    return 1;
+}
+
+void smp_wait(int index) {
+    if (index <= 0 || index >= cpu_count) return;
+    while (__atomic_load_n(&cpus[index].mailbox_busy, __ATOMIC_ACQUIRE)) {
+        __asm__ volatile ("pause");
+    }
+}
+
+uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        // Wait on plain reads so the line is not pulled back and forth
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            __asm__ volatile ("pause");
+        }
+    }
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+void smp_dump_info(void) {
+    if (!have_madt) {
+        kprintf("SMP: no MADT, running on the boot processor only\n");
+        return;
+    }
+    kprintf("SMP: %d of %d CPUs online, local APIC at 0x%08x, %d I/O APIC(s)%s\n",
+            cpu_count, madt.cpu_count, madt.lapic_address, madt.ioapic_count,
+            madt.has_8259 ? ", 8259 PICs" : "");
+    for (int i = 0; i < cpu_count; i++) {
+        kprintf("  CPU %d: APIC ID %u, %s, %u work items run\n", i, cpus[i].apic_id,
+                i == 0 ? "boot processor" : "idle loop", cpus[i].work_done);
+    }
+}
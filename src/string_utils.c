@@ -1,11 +1,387 @@
 #include <stddef.h>
 #include "string_utils.h"
 
-// Custom string functions to avoid conflicts with builtin functions
+// Word-sized access that may alias any object
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+#define ONES_32  0x01010101U
+#define HIGHS_32 0x80808080U
+#define HAS_ZERO_BYTE(v) (((v) - ONES_32) & ~(v) & HIGHS_32)
+#define SSE2_MIN_SIZE 64                  // Below this the setup costs more than it saves
+#define NONTEMPORAL_MIN_SIZE (256 * 1024) // Bigger than L2: bypass the cache
+
+// Only the SSE2 routines may touch xmm registers; the rest of the kernel is
+// built without SSE so it runs before (or without) SSE being enabled
+#define SSE2_FN __attribute__((target("sse2")))
+
+// ---- i386 versions: rep string instructions and word-at-a-time scans ----
+
+static void* memcpy_rep(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    size_t words = n >> 2;
+    __asm__ volatile (
+        "rep movsl\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep movsb"
+        : "+D"(d), "+S"(src), "+c"(words)
+        : "r"((uint32_t)(n & 3))
+        : "memory");
+    return dest;
+}
+
+static void* memset_rep(void* s, int c, size_t n) {
+    void* d = s;
+    size_t words = n >> 2;
+    __asm__ volatile (
+        "rep stosl\n\t"
+        "movl %3, %%ecx\n\t"
+        "rep stosb"
+        : "+D"(d), "+c"(words)
+        : "a"((uint32_t)(unsigned char)c * ONES_32), "r"((uint32_t)(n & 3))
+        : "memory");
+    return s;
+}
+
+static int memcmp_word(const void* a, const void* b, size_t n) {
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    
+    // Skip equal words, then locate the differing byte
+    while (n >= 4 && *(const word_t*)x == *(const word_t*)y) {
+        x += 4;
+        y += 4;
+        n -= 4;
+    }
+    for (; n > 0; n--, x++, y++) {
+        if (*x != *y) return *x - *y;
+    }
+    return 0;
+}
+
+static size_t strlen_word(const char* s) {
+    const char* p = s;
+    
+    // Byte steps up to a word boundary, so aligned reads never cross a page
+    while ((size_t)p & 3) {
+        if (!*p) return p - s;
+        p++;
+    }
+    while (!HAS_ZERO_BYTE(*(const word_t*)p)) {
+        p += 4;
+    }
+    while (*p) p++;
+    return p - s;
+}
+
+static void* memchr_word(const void* s, int c, size_t n) {
+    const unsigned char* p = (const unsigned char*)s;
+    unsigned char target = (unsigned char)c;
+    uint32_t pattern = target * ONES_32;
+    
+    while (n >= 4) {
+        uint32_t v = *(const word_t*)p ^ pattern;
+        if (HAS_ZERO_BYTE(v)) break;
+        p += 4;
+        n -= 4;
+    }
+    for (; n > 0; n--, p++) {
+        if (*p == target) return (void*)p;
+    }
+    return NULL;
+}
+
+// ---- ERMS: rep movsb/stosb are fast for any size on these CPUs ----
+
+static void* memcpy_erms(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    __asm__ volatile ("rep movsb" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+    return dest;
+}
+
+static void* memset_erms(void* s, int c, size_t n) {
+    void* d = s;
+    __asm__ volatile ("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+    return s;
+}
+
+// ---- SSE2: 16 bytes per instruction; needs SSE enabled in CR0/CR4 ----
+
+SSE2_FN static void* memcpy_sse2(void* dest, const void* src, size_t n) {
+    if (n < SSE2_MIN_SIZE) return memcpy_rep(dest, src, n);
+    
+    unsigned char* d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    
+    // Align the destination so the stores can be aligned
+    size_t head = (16 - ((size_t)d & 15)) & 15;
+    memcpy_rep(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    
+    size_t blocks = n >> 6;
+    if (blocks) {
+        if (n >= NONTEMPORAL_MIN_SIZE) {
+            __asm__ volatile (
+                "1:\n\t"
+                "movdqu   (%1), %%xmm0\n\t"
+                "movdqu 16(%1), %%xmm1\n\t"
+                "movdqu 32(%1), %%xmm2\n\t"
+                "movdqu 48(%1), %%xmm3\n\t"
+                "movntdq %%xmm0,   (%0)\n\t"
+                "movntdq %%xmm1, 16(%0)\n\t"
+                "movntdq %%xmm2, 32(%0)\n\t"
+                "movntdq %%xmm3, 48(%0)\n\t"
+                "add $64, %1\n\t"
+                "add $64, %0\n\t"
+                "dec %2\n\t"
+                "jnz 1b\n\t"
+                "sfence"
+                : "+r"(d), "+r"(s), "+r"(blocks)
+                :
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+        } else {
+            __asm__ volatile (
+                "1:\n\t"
+                "movdqu   (%1), %%xmm0\n\t"
+                "movdqu 16(%1), %%xmm1\n\t"
+                "movdqu 32(%1), %%xmm2\n\t"
+                "movdqu 48(%1), %%xmm3\n\t"
+                "movdqa %%xmm0,   (%0)\n\t"
+                "movdqa %%xmm1, 16(%0)\n\t"
+                "movdqa %%xmm2, 32(%0)\n\t"
+                "movdqa %%xmm3, 48(%0)\n\t"
+                "add $64, %1\n\t"
+                "add $64, %0\n\t"
+                "dec %2\n\t"
+                "jnz 1b"
+                : "+r"(d), "+r"(s), "+r"(blocks)
+                :
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+        }
+    }
+    
+    memcpy_rep(d, s, n & 63);
+    return dest;
+}
+
+SSE2_FN static void* memset_sse2(void* s, int c, size_t n) {
+    if (n < SSE2_MIN_SIZE) return memset_rep(s, c, n);
+    
+    unsigned char* d = (unsigned char*)s;
+    uint32_t pattern[4] __attribute__((aligned(16)));
+    pattern[0] = pattern[1] = pattern[2] = pattern[3] = (uint32_t)(unsigned char)c * ONES_32;
+    
+    size_t head = (16 - ((size_t)d & 15)) & 15;
+    memset_rep(d, c, head);
+    d += head;
+    n -= head;
+    
+    size_t blocks = n >> 6;
+    if (blocks) {
+        if (n >= NONTEMPORAL_MIN_SIZE) {
+            __asm__ volatile (
+                "movdqa (%2), %%xmm0\n\t"
+                "1:\n\t"
+                "movntdq %%xmm0,   (%0)\n\t"
+                "movntdq %%xmm0, 16(%0)\n\t"
+                "movntdq %%xmm0, 32(%0)\n\t"
+                "movntdq %%xmm0, 48(%0)\n\t"
+                "add $64, %0\n\t"
+                "dec %1\n\t"
+                "jnz 1b\n\t"
+                "sfence"
+                : "+r"(d), "+r"(blocks)
+                : "r"(pattern)
+                : "memory", "xmm0");
+        } else {
+            __asm__ volatile (
+                "movdqa (%2), %%xmm0\n\t"
+                "1:\n\t"
+                "movdqa %%xmm0,   (%0)\n\t"
+                "movdqa %%xmm0, 16(%0)\n\t"
+                "movdqa %%xmm0, 32(%0)\n\t"
+                "movdqa %%xmm0, 48(%0)\n\t"
+                "add $64, %0\n\t"
+                "dec %1\n\t"
+                "jnz 1b"
+                : "+r"(d), "+r"(blocks)
+                : "r"(pattern)
+                : "memory", "xmm0");
+        }
+    }
+    
+    memset_rep(d, c, n & 63);
+    return s;
+}
+
+// Bitmask of the bytes that are equal in two 16-byte blocks
+SSE2_FN static inline uint32_t sse2_equal_mask(const void* a, const void* b) {
+    uint32_t mask;
+    __asm__ volatile (
+        "movdqu (%1), %%xmm0\n\t"
+        "movdqu (%2), %%xmm1\n\t"
+        "pcmpeqb %%xmm1, %%xmm0\n\t"
+        "pmovmskb %%xmm0, %0"
+        : "=r"(mask)
+        : "r"(a), "r"(b)
+        : "memory", "xmm0", "xmm1");
+    return mask;
+}
+
+// Bitmask of the bytes of an aligned 16-byte block equal to `pattern`
+SSE2_FN static inline uint32_t sse2_match_mask(const void* block, const uint32_t* pattern) {
+    uint32_t mask;
+    __asm__ volatile (
+        "movdqa (%1), %%xmm0\n\t"
+        "pcmpeqb (%2), %%xmm0\n\t"
+        "pmovmskb %%xmm0, %0"
+        : "=r"(mask)
+        : "r"(block), "r"(pattern)
+        : "memory", "xmm0");
+    return mask;
+}
+
+SSE2_FN static int memcmp_sse2(const void* a, const void* b, size_t n) {
+    const unsigned char* x = (const unsigned char*)a;
+    const unsigned char* y = (const unsigned char*)b;
+    
+    while (n >= 16) {
+        uint32_t mask = sse2_equal_mask(x, y);
+        if (mask != 0xFFFF) {
+            int i = __builtin_ctz(~mask);
+            return x[i] - y[i];
+        }
+        x += 16;
+        y += 16;
+        n -= 16;
+    }
+    return memcmp_word(x, y, n);
+}
+
+SSE2_FN static size_t strlen_sse2(const char* s) {
+    static const uint32_t zero[4] __attribute__((aligned(16))) = {0, 0, 0, 0};
+    
+    // Aligned 16-byte blocks never cross a page; ignore bytes before `s`
+    const char* p = (const char*)((size_t)s & ~(size_t)15);
+    uint32_t mask = sse2_match_mask(p, zero) >> (s - p);
+    if (mask) return __builtin_ctz(mask);
+    
+    for (;;) {
+        p += 16;
+        mask = sse2_match_mask(p, zero);
+        if (mask) return p + __builtin_ctz(mask) - s;
+    }
+}
+
+SSE2_FN static void* memchr_sse2(const void* s, int c, size_t n) {
+    const unsigned char* p = (const unsigned char*)s;
+    uint32_t pattern[4] __attribute__((aligned(16)));
+    pattern[0] = pattern[1] = pattern[2] = pattern[3] = (uint32_t)(unsigned char)c * ONES_32;
+    
+    while (n >= 16) {
+        uint32_t mask = sse2_equal_mask(p, pattern);
+        if (mask) return (void*)(p + __builtin_ctz(mask));
+        p += 16;
+        n -= 16;
+    }
+    return memchr_word(p, c, n);
+}
+
+// ---- Dispatch ----
+
+typedef struct {
+    const char* name;
+    void* (*copy)(void* dest, const void* src, size_t n);
+    void* (*fill)(void* s, int c, size_t n);
+    int (*compare)(const void* a, const void* b, size_t n);
+    size_t (*length)(const char* s);
+    void* (*find)(const void* s, int c, size_t n);
+} string_ops_t;
+
+static string_ops_t string_ops = {
+    "i386", memcpy_rep, memset_rep, memcmp_word, strlen_word, memchr_word
+};
+
+// Pick the fastest routines the CPU supports. SSE2 may only be requested
+// once SSE has been enabled in CR0/CR4.
+void string_select_variants(int use_sse2, int use_erms) {
+    if (use_sse2) {
+        string_ops.copy = memcpy_sse2;
+        string_ops.fill = memset_sse2;
+        string_ops.compare = memcmp_sse2;
+        string_ops.length = strlen_sse2;
+        string_ops.find = memchr_sse2;
+    }
+    // With ERMS, microcoded rep movsb/stosb beats a vector loop
+    if (use_erms) {
+        string_ops.copy = memcpy_erms;
+        string_ops.fill = memset_erms;
+    }
+    
+    if (use_sse2 && use_erms) {
+        string_ops.name = "sse2+erms";
+    } else if (use_sse2) {
+        string_ops.name = "sse2";
+    } else if (use_erms) {
+        string_ops.name = "erms";
+    }
+}
+
+const char* string_variant_name(void) {
+    return string_ops.name;
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    return string_ops.copy(dest, src, n);
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    unsigned char* d = (unsigned char*)dest;
+    const unsigned char* s = (const unsigned char*)src;
+    
+    // A forward copy is safe unless the destination overlaps the source's tail
+    if (d <= s || d >= s + n) {
+        return string_ops.copy(dest, src, n);
+    }
+    
+    // Copy backwards, a word at a time once the tail bytes are done
+    d += n;
+    s += n;
+    while (n & 3) {
+        *--d = *--s;
+        n--;
+    }
+    while (n) {
+        d -= 4;
+        s -= 4;
+        *(word_t*)d = *(const word_t*)s;
+        n -= 4;
+    }
+    return dest;
+}
+
+void* memset(void* s, int c, size_t n) {
+    return string_ops.fill(s, c, n);
+}
+
+int memcmp(const void* a, const void* b, size_t n) {
+    return string_ops.compare(a, b, n);
+}
+
+void* memchr(const void* s, int c, size_t n) {
+    return string_ops.find(s, c, n);
+}
+
+// Fill `count` 16-bit cells, e.g. VGA character/attribute pairs
+void* memsetw(void* s, uint16_t value, size_t count) {
+    void* d = s;
+    __asm__ volatile ("rep stosw" : "+D"(d), "+c"(count) : "a"(value) : "memory");
+    return s;
+}
+
 size_t my_strlen(const char* s) {
-    size_t i = 0;
-    while (s[i]) i++;
-    return i;
+    return string_ops.length(s);
 }
 
 char* strcpy(char* dest, const char* src) {
@@ -167,17 +543,6 @@ char* itoa_hex(uint32_t value, char* str) {
     return str;
 }
 
-void* memset(void* s, int c, size_t n) {
-    unsigned char* ptr = (unsigned char*)s;
-    unsigned char value = (unsigned char)c;
-    
-    for (size_t i = 0; i < n; i++) {
-        ptr[i] = value;
-    }
-    
-    return s;
-}
-
 // Safe string functions to prevent buffer overflows
 char* safe_strcpy(char* dest, const char* src, size_t dest_size) {
     if (!dest || !src || dest_size == 0) return dest;
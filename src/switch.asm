@@ -0,0 +1,28 @@
+; تبديل السياق بين خيوط النواة
+[bits 32]
+
+section .text
+
+; void thread_switch(uint32_t* save, uint32_t load)
+; Push the registers a C call must preserve, park the stack pointer in
+; *save and resume the thread whose stack pointer is `load`. That thread
+; returns from its own earlier call here or, the first time, enters
+; thread_start through the frame new_thread() built.
+global thread_switch
+thread_switch:
+    mov eax, [esp + 4]
+    mov edx, [esp + 8]
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov [eax], esp
+    mov esp, edx
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; إضافة .note.GNU-stack section لحل التحذير
+section .note.GNU-stack noalloc noexec nowrite progbits
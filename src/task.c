@@ -0,0 +1,235 @@
+#include "task.h"
+#include "smp.h"
+#include "thread.h"
+#include "interrupts.h"
+#include "kprintf.h"
+
+#define CACHE_LINE_SIZE 64
+
+// Pool states. A session ends in two steps so that no new one can call
+// the APs in before the last one's worker loops have returned.
+#define POOL_IDLE 0
+#define POOL_ACTIVE 1
+#define POOL_ENDING 2
+
+// One per CPU. Thieves write `top`, the owner `bottom`; they are kept on
+// separate cache lines, as are the workers themselves.
+typedef struct {
+    volatile int32_t top;
+    uint8_t padding[CACHE_LINE_SIZE - sizeof(int32_t)];
+    volatile int32_t bottom;
+    task_t* volatile slots[TASK_DEQUE_SIZE];
+    uint32_t seed;                      // For picking victims
+    uint32_t run;                       // Tasks run by this worker
+    uint32_t stolen;                    // ... of which taken from another
+} __attribute__((aligned(CACHE_LINE_SIZE))) worker_t;
+
+static worker_t workers[SMP_MAX_CPUS];
+static volatile int pool_state = POOL_IDLE;
+static thread_t* pool_owner = 0;
+static uint32_t owner_pending = 0;      // Spawned by the owner, not yet waited on
+
+// Owner only. 0 if the deque is full.
+static int deque_push(worker_t* worker, task_t* task) {
+    int32_t bottom = worker->bottom;
+    int32_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= TASK_DEQUE_SIZE) return 0;
+    
+    worker->slots[bottom & (TASK_DEQUE_SIZE - 1)] = task;
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Owner only: take the newest task. The bottom is claimed before top is
+// read, and the fence keeps the two in that order, so only the last task
+// can be contested by a thief.
+static task_t* deque_pop(worker_t* worker) {
+    int32_t bottom = worker->bottom - 1;
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int32_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+    
+    if (top > bottom) {
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    task_t* task = worker->slots[bottom & (TASK_DEQUE_SIZE - 1)];
+    if (top == bottom) {
+        if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            task = 0;
+        }
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+// Any worker: take the oldest task, 0 if empty or another thief won
+static task_t* deque_steal(worker_t* worker) {
+    int32_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int32_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) return 0;
+    
+    task_t* task = worker->slots[top & (TASK_DEQUE_SIZE - 1)];
+    if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return task;
+}
+
+static void run_task(worker_t* worker, task_t* task) {
+    task->fn(task->arg);
+    if (worker) worker->run++;
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+// Try every other worker once, starting at a random one (xorshift)
+static task_t* steal_any(worker_t* self) {
+    int count = smp_cpu_count();
+    uint32_t seed = self->seed ? self->seed : (uint32_t)(self - workers) + 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    self->seed = seed;
+    
+    int start = seed % count;
+    for (int i = 0; i < count; i++) {
+        worker_t* victim = &workers[(start + i) % count];
+        if (victim == self) continue;
+        task_t* task = deque_steal(victim);
+        if (task) {
+            self->stolen++;
+            return task;
+        }
+    }
+    return 0;
+}
+
+// Find a task and run it; 0 if there was none
+static int run_one(worker_t* self) {
+    task_t* task = deque_pop(self);
+    if (!task) task = steal_any(self);
+    if (!task) return 0;
+    run_task(self, task);
+    return 1;
+}
+
+// What an AP runs from its mailbox for the length of a session
+static void worker_loop(void* arg) {
+    worker_t* self = arg;
+    while (__atomic_load_n(&pool_state, __ATOMIC_ACQUIRE) == POOL_ACTIVE) {
+        if (!run_one(self)) __asm__ volatile ("pause");
+    }
+}
+
+// Worker of the caller, or NULL if its tasks run inline. APs only run
+// tasks during a session; on the BSP only the owning thread has a worker.
+static worker_t* current_worker(void) {
+    int cpu = smp_cpu_index();
+    if (cpu != 0) return &workers[cpu];
+    if (pool_state == POOL_ACTIVE && pool_owner == thread_current()) return &workers[0];
+    return 0;
+}
+
+// Make the calling BSP thread the owner and call the APs in; 0 if there
+// are no APs or another thread has the pool
+static int begin_session(void) {
+    int count = smp_cpu_count();
+    if (count < 2 || smp_cpu_index() != 0) return 0;
+    
+    uint32_t flags = irq_save();
+    int claimed = pool_state == POOL_IDLE;
+    if (claimed) {
+        pool_owner = thread_current();
+        owner_pending = 0;
+        __atomic_store_n(&pool_state, POOL_ACTIVE, __ATOMIC_RELEASE);
+    }
+    irq_restore(flags);
+    if (!claimed) return 0;
+    
+    for (int i = 1; i < count; i++) {
+        smp_call(i, worker_loop, &workers[i]);
+    }
+    return 1;
+}
+
+static void end_session(void) {
+    __atomic_store_n(&pool_state, POOL_ENDING, __ATOMIC_RELEASE);
+    for (int i = 1; i < smp_cpu_count(); i++) {
+        smp_wait(i);
+    }
+    __atomic_store_n(&pool_state, POOL_IDLE, __ATOMIC_RELEASE);
+}
+
+void task_spawn(task_t* task, task_fn fn, void* arg) {
+    task->fn = fn;
+    task->arg = arg;
+    task->done = 0;
+    
+    worker_t* self = current_worker();
+    if (!self && begin_session()) self = &workers[0];
+    if (self == &workers[0]) owner_pending++;
+    
+    if (!self || !deque_push(self, task)) run_task(self, task);
+}
+
+void task_wait(task_t* task) {
+    worker_t* self = current_worker();
+    
+    // Help with whatever is queued rather than sit idle
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        if (!self || !run_one(self)) __asm__ volatile ("pause");
+    }
+    if (self == &workers[0] && --owner_pending == 0) end_session();
+}
+
+typedef struct {
+    task_range_fn fn;
+    void* arg;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t grain;
+} range_t;
+
+// Offer the upper half for stealing and recurse into the lower one
+static void run_range(void* data) {
+    range_t* range = data;
+    if (range->end - range->begin <= range->grain) {
+        range->fn(range->arg, range->begin, range->end);
+        return;
+    }
+    
+    uint32_t middle = range->begin + (range->end - range->begin) / 2;
+    range_t upper = *range;
+    range_t lower = *range;
+    upper.begin = middle;
+    lower.end = middle;
+    
+    task_t task;
+    task_spawn(&task, run_range, &upper);
+    run_range(&lower);
+    task_wait(&task);
+}
+
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, task_range_fn fn, void* arg) {
+    if (end <= begin) return;
+    
+    // Several chunks per CPU evens out uneven ones
+    if (!grain) grain = (end - begin) / (smp_cpu_count() * 8);
+    if (!grain) grain = 1;
+    
+    range_t range = { fn, arg, begin, end, grain };
+    run_range(&range);
+}
+
+void task_dump_info(void) {
+    static const char* const state_names[] = { "idle", "active", "ending" };
+    
+    kprintf("Tasks: %d worker(s), %d-entry deques, pool %s\n",
+            smp_cpu_count(), TASK_DEQUE_SIZE, state_names[pool_state]);
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        kprintf("  Worker %d: %u tasks run, %u stolen\n", i, workers[i].run, workers[i].stolen);
+    }
+}
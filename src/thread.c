@@ -0,0 +1,431 @@
+#include "thread.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "slab.h"
+#include "smp.h"
+#include "kprintf.h"
+#include "string_utils.h"
+
+// In switch.asm: push the callee-saved registers, store the stack pointer
+// in *save and continue on the stack `load`
+extern void thread_switch(uint32_t* save, uint32_t load);
+
+static thread_t boot_thread;
+static kmem_cache_t* thread_cache = 0;  // Every thread but the boot one
+static thread_t* idle_thread = 0;
+static thread_t* current = &boot_thread;
+static thread_t* all_threads = 0;
+static thread_t* run_head[THREAD_PRIORITY_COUNT];
+static thread_t* run_tail[THREAD_PRIORITY_COUNT];
+static thread_t* reap_pending = 0;      // Exited thread whose stack was still in use
+static wait_queue_t interrupt_waiters;
+static wait_queue_t exit_waiters;
+static wait_queue_t console_waiters;
+static uint32_t next_id = 1;
+static int running = 0;
+static volatile int need_resched = 0;
+static volatile int preempt_count = 0;
+static int switch_fpu = 0;              // CR4.OSFXSR was set at thread_init()
+static uint8_t initial_fpu_state[THREAD_FPU_STATE_SIZE] __attribute__((aligned(16)));
+
+static void enqueue(thread_t* thread) {
+    int priority = thread->priority;
+    thread->state = THREAD_READY;
+    thread->next = 0;
+    if (run_tail[priority]) {
+        run_tail[priority]->next = thread;
+    } else {
+        run_head[priority] = thread;
+    }
+    run_tail[priority] = thread;
+}
+
+static thread_t* dequeue(void) {
+    for (int priority = 0; priority < THREAD_PRIORITY_COUNT; priority++) {
+        thread_t* thread = run_head[priority];
+        if (!thread) continue;
+        run_head[priority] = thread->next;
+        if (!run_head[priority]) run_tail[priority] = 0;
+        thread->next = 0;
+        return thread;
+    }
+    return 0;
+}
+
+// Best priority with a ready thread, THREAD_PRIORITY_COUNT if none
+static int best_ready(void) {
+    for (int priority = 0; priority < THREAD_PRIORITY_COUNT; priority++) {
+        if (run_head[priority]) return priority;
+    }
+    return THREAD_PRIORITY_COUNT;
+}
+
+// Free an exited thread once we are off its stack
+static void finish_switch(void) {
+    if (reap_pending) {
+        thread_t* dead = reap_pending;
+        reap_pending = 0;
+        free(dead->stack);
+        kmem_cache_free(thread_cache, dead);
+    }
+}
+
+// Pick the next thread and switch to it. Interrupts must be off. The
+// running thread goes to the back of its queue unless it blocked.
+static void schedule(void) {
+    thread_t* previous = current;
+    need_resched = 0;
+    
+    if (previous == idle_thread) {
+        previous->state = THREAD_READY;
+    } else if (previous->state == THREAD_RUNNING) {
+        enqueue(previous);
+    }
+    thread_t* next = dequeue();
+    if (!next) next = idle_thread;
+    next->state = THREAD_RUNNING;
+    next->slice = THREAD_TIME_SLICE;
+    if (next == previous) return;
+    
+    current = next;
+    if (switch_fpu) {
+        __asm__ volatile ("fxsave %0" : "=m"(previous->fpu_state));
+        __asm__ volatile ("fxrstor %0" : : "m"(next->fpu_state));
+    }
+    thread_switch(&previous->esp, next->esp);
+    finish_switch();
+}
+
+static void wake(thread_t* thread) {
+    if (thread->state != THREAD_BLOCKED) return;
+    enqueue(thread);
+    if (current == idle_thread || thread->priority < current->priority) need_resched = 1;
+}
+
+static void wake_sleeper(void* data) {
+    wake((thread_t*)data);
+}
+
+// Switch now if a better thread became ready while preemption was held off
+static void preempt_check(void) {
+    if (!need_resched || preempt_count || !interrupts_enabled()) return;
+    if (smp_cpu_index() != 0) return;
+    
+    uint32_t flags = irq_save();
+    if (need_resched && !preempt_count) schedule();
+    irq_restore(flags);
+}
+
+// First code of every new thread: thread_switch() "returns" here
+static void thread_start(void) {
+    finish_switch();
+    interrupts_enable();
+    current->entry(current->arg);
+    thread_exit();
+}
+
+static void idle_loop(void* arg) {
+    (void)arg;
+    // Whatever interrupt makes a thread ready switches to it on the way out
+    for (;;) {
+        __asm__ volatile ("sti\n hlt");
+    }
+}
+
+// Allocate a thread and build the frame thread_switch() expects: four
+// saved registers, then the address to return to
+static thread_t* new_thread(const char* name, thread_fn entry, void* arg, int priority) {
+    thread_t* thread = kmem_cache_alloc(thread_cache);
+    uint8_t* stack = malloc_aligned(THREAD_STACK_SIZE, 16);
+    if (!thread || !stack) {
+        kmem_cache_free(thread_cache, thread);
+        free(stack);
+        return 0;
+    }
+    
+    memset(thread, 0, sizeof(thread_t));
+    SAFE_STRCPY(thread->name, name, THREAD_NAME_LENGTH);
+    thread->priority = priority;
+    thread->stack = stack;
+    thread->entry = entry;
+    thread->arg = arg;
+    timer_event_init(&thread->wakeup, wake_sleeper, thread);
+    memcpy(thread->fpu_state, initial_fpu_state, THREAD_FPU_STATE_SIZE);
+    
+    uint32_t* top = (uint32_t*)(stack + THREAD_STACK_SIZE);
+    *--top = 0;                         // thread_start's own return address
+    *--top = (uint32_t)thread_start;
+    *--top = 0;                         // ebp
+    *--top = 0;                         // ebx
+    *--top = 0;                         // esi
+    *--top = 0;                         // edi
+    thread->esp = (uint32_t)top;
+    
+    uint32_t flags = irq_save();
+    thread->id = next_id++;
+    thread->next_all = all_threads;
+    all_threads = thread;
+    irq_restore(flags);
+    return thread;
+}
+
+void thread_init(const char* name) {
+    if (running) return;
+    
+    SAFE_STRCPY(boot_thread.name, name, THREAD_NAME_LENGTH);
+    boot_thread.id = next_id++;
+    boot_thread.priority = THREAD_PRIORITY_NORMAL;
+    boot_thread.state = THREAD_RUNNING;
+    boot_thread.slice = THREAD_TIME_SLICE;
+    timer_event_init(&boot_thread.wakeup, wake_sleeper, &boot_thread);
+    all_threads = &boot_thread;
+    
+    // New threads start from a clean FPU, with this CPU's MXCSR
+    uint32_t cr4;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    switch_fpu = (cr4 >> 9) & 1;
+    if (switch_fpu) {
+        __asm__ volatile ("fxsave %0" : "=m"(boot_thread.fpu_state));
+        __asm__ volatile ("fninit\n fxsave %0" : "=m"(initial_fpu_state));
+        __asm__ volatile ("fxrstor %0" : : "m"(boot_thread.fpu_state));
+    }
+    
+    thread_cache = kmem_cache_create("thread", sizeof(thread_t), 0, NULL);
+    if (!thread_cache) return;
+    
+    // Runs only when nothing else is ready, so it sits outside the queues
+    idle_thread = new_thread("idle", idle_loop, 0, THREAD_PRIORITY_LOW);
+    if (!idle_thread) return;
+    idle_thread->state = THREAD_READY;
+    running = 1;
+}
+
+int thread_scheduler_running(void) {
+    return running;
+}
+
+uint32_t thread_create(const char* name, thread_fn entry, void* arg, int priority) {
+    if (!running || !entry) return 0;
+    if (priority < 0 || priority >= THREAD_PRIORITY_COUNT) priority = THREAD_PRIORITY_NORMAL;
+    
+    thread_t* thread = new_thread(name, entry, arg, priority);
+    if (!thread) return 0;
+    
+    uint32_t flags = irq_save();
+    enqueue(thread);
+    if (priority < current->priority) need_resched = 1;
+    irq_restore(flags);
+    
+    preempt_check();
+    return thread->id;
+}
+
+void thread_exit(void) {
+    interrupts_disable();
+    thread_t* self = current;
+    
+    thread_t** link = &all_threads;
+    while (*link && *link != self) link = &(*link)->next_all;
+    if (*link) *link = self->next_all;
+    
+    timer_cancel(&self->wakeup);
+    self->state = THREAD_DEAD;
+    thread_wake_all(&exit_waiters);
+    if (self->stack) reap_pending = self;
+    schedule();
+    
+    for (;;) {
+        __asm__ volatile ("cli\n hlt");
+    }
+}
+
+thread_t* thread_current(void) {
+    return running ? current : 0;
+}
+
+void thread_yield(void) {
+    if (!running) return;
+    uint32_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_sleep_ms(uint32_t ms) {
+    if (!running || current == idle_thread || preempt_count || !interrupts_enabled()) {
+        ksleep_ms(ms);
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    timer_start(&current->wakeup, ms, 0);
+    current->state = THREAD_BLOCKED;
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_set_output(thread_output_fn output, void* data) {
+    if (!running) return;
+    preempt_disable();
+    current->output = output;
+    current->output_data = data;
+    preempt_enable();
+}
+
+void thread_set_scratch(arena_t* arena) {
+    if (running) current->scratch = arena;
+}
+
+// An empty write tells whether the sink still takes the output
+static int output_redirected(thread_t* thread) {
+    return thread->output && thread->output(thread->output_data, "", 0);
+}
+
+void thread_wait_console(void) {
+    if (!running) return;
+    
+    uint32_t flags = irq_save();
+    while (output_redirected(current)) {
+        current->input_blocked = 1;
+        thread_block(&console_waiters);
+    }
+    current->input_blocked = 0;
+    irq_restore(flags);
+}
+
+void thread_console_changed(void) {
+    if (!running) return;
+    uint32_t flags = irq_save();
+    thread_wake_all(&console_waiters);
+    irq_restore(flags);
+    preempt_check();
+}
+
+// Interrupts off
+static int find_thread(uint32_t id) {
+    for (thread_t* thread = all_threads; thread; thread = thread->next_all) {
+        if (thread->id == id) return 1;
+    }
+    return 0;
+}
+
+int thread_exists(uint32_t id) {
+    uint32_t flags = irq_save();
+    int found = find_thread(id);
+    irq_restore(flags);
+    return found;
+}
+
+void thread_join(uint32_t id) {
+    if (!running || id == current->id) return;
+    
+    uint32_t flags = irq_save();
+    while (find_thread(id)) {
+        thread_block(&exit_waiters);
+    }
+    irq_restore(flags);
+}
+
+void thread_block(wait_queue_t* queue) {
+    current->state = THREAD_BLOCKED;
+    current->next = queue->head;
+    queue->head = current;
+    schedule();
+}
+
+void thread_wake_all(wait_queue_t* queue) {
+    thread_t* thread = queue->head;
+    queue->head = 0;
+    while (thread) {
+        thread_t* next = thread->next;
+        wake(thread);
+        thread = next;
+    }
+}
+
+int thread_wait_interrupt(void) {
+    if (!running || current == idle_thread || preempt_count) return 0;
+    if (smp_cpu_index() != 0) return 0;
+    
+    uint32_t flags = irq_save();
+    thread_block(&interrupt_waiters);
+    irq_restore(flags);
+    return 1;
+}
+
+void preempt_disable(void) {
+    preempt_count++;
+}
+
+void preempt_enable(void) {
+    if (--preempt_count == 0) preempt_check();
+}
+
+// Timer interrupt: charge the tick and end the slice if another thread of
+// the same or better priority is waiting
+void thread_tick(void) {
+    if (!running) return;
+    current->ticks++;
+    
+    if (current == idle_thread) {
+        if (best_ready() < THREAD_PRIORITY_COUNT) need_resched = 1;
+        return;
+    }
+    if (current->slice > 0) current->slice--;
+    if (current->slice == 0) {
+        if (best_ready() <= current->priority) {
+            need_resched = 1;
+        } else {
+            current->slice = THREAD_TIME_SLICE;
+        }
+    }
+}
+
+// End of an IRQ, after the EOI: any interrupt may be what a polling thread
+// was waiting for, and a preempted thread resumes from its own frame
+void thread_irq_exit(void) {
+    if (!running) return;
+    if (interrupt_waiters.head) thread_wake_all(&interrupt_waiters);
+    if (need_resched && !preempt_count) schedule();
+}
+
+static const char* state_name(thread_state_t state) {
+    switch (state) {
+        case THREAD_READY: return "ready";
+        case THREAD_RUNNING: return "running";
+        case THREAD_BLOCKED: return "blocked";
+        default: return "dead";
+    }
+}
+
+void thread_dump_info(void) {
+    static const char* const priority_names[THREAD_PRIORITY_COUNT] = { "high", "normal", "low" };
+    
+    if (!running) {
+        kprintf("Scheduler not started\n");
+        return;
+    }
+    
+    uint32_t hz = timer_frequency() ? timer_frequency() : 1;
+    kprintf("  ID  PRIORITY  STATE      CPU(ms)  NAME\n");
+    
+    // Copy each line out with interrupts off, print with them on
+    uint32_t id = 0;
+    for (;;) {
+        thread_t copy;
+        int found = 0;
+        uint32_t flags = irq_save();
+        for (thread_t* thread = all_threads; thread; thread = thread->next_all) {
+            if (thread->id > id && (!found || thread->id < copy.id)) {
+                copy = *thread;
+                found = 1;
+            }
+        }
+        irq_restore(flags);
+        if (!found) break;
+        
+        id = copy.id;
+        kprintf("%4u  %-8s  %-9s %8u  %s\n", copy.id,
+                copy.id == idle_thread->id ? "idle" : priority_names[copy.priority],
+                state_name(copy.state), (unsigned int)(copy.ticks * 1000 / hz), copy.name);
+    }
+}
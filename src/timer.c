@@ -0,0 +1,220 @@
+#include "timer.h"
+#include "interrupts.h"
+#include "io.h"
+#include "kprintf.h"
+#include "thread.h"
+
+// 8253/8254 ports
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND 0x43
+#define PIT_CH0_RATE_GENERATOR 0x34 // Channel 0, low then high byte, mode 2
+#define PIT_CH0_LATCH 0x00          // Freeze the channel 0 count for reading
+
+static volatile uint64_t ticks = 0;
+static uint32_t frequency = 0;
+static uint32_t divisor = 0;        // PIT clocks per tick
+static int tick_running = 0;        // IRQ 0 handler installed
+
+// Hashed timer wheel: an event sits in the slot of its expiry tick and is
+// checked once per lap until its tick comes round. Lists are doubly
+// linked so that starting and cancelling are O(1).
+static timer_event_t* wheel[TIMER_WHEEL_SLOTS];
+static unsigned int events_pending = 0;
+
+static void wheel_link(timer_event_t* event) {
+    timer_event_t** slot = &wheel[event->expires & (TIMER_WHEEL_SLOTS - 1)];
+    event->prev = 0;
+    event->next = *slot;
+    if (*slot) (*slot)->prev = event;
+    *slot = event;
+    event->pending = 1;
+    events_pending++;
+}
+
+static void wheel_unlink(timer_event_t* event) {
+    if (event->prev) {
+        event->prev->next = event->next;
+    } else {
+        wheel[event->expires & (TIMER_WHEEL_SLOTS - 1)] = event->next;
+    }
+    if (event->next) event->next->prev = event->prev;
+    event->next = event->prev = 0;
+    event->pending = 0;
+    events_pending--;
+}
+
+// Fire whatever in the current slot has reached its tick. The slot is
+// rescanned after each callback, since a callback may start or cancel
+// other events, including ones in this slot.
+static void wheel_run(uint64_t now) {
+    timer_event_t* event = wheel[now & (TIMER_WHEEL_SLOTS - 1)];
+    
+    while (event) {
+        if (event->expires > now) {
+            event = event->next;
+            continue;
+        }
+        wheel_unlink(event);
+        if (event->period) {
+            event->expires = now + event->period;
+            wheel_link(event);
+        }
+        event->callback(event->data);
+        event = wheel[now & (TIMER_WHEEL_SLOTS - 1)];
+    }
+}
+
+static void timer_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    ticks++;
+    wheel_run(ticks);
+    thread_tick();
+}
+
+void timer_set_frequency(uint32_t hz) {
+    // A divisor of 0 means 65536, the slowest rate (about 18.2 Hz)
+    uint32_t new_divisor = hz ? PIT_BASE_FREQUENCY / hz : 65536;
+    if (new_divisor < 2) new_divisor = 2;
+    if (new_divisor > 65536) new_divisor = 65536;
+    
+    uint32_t flags = irq_save();
+    outb(PIT_COMMAND, PIT_CH0_RATE_GENERATOR);
+    outb(PIT_CHANNEL0, new_divisor & 0xFF);
+    outb(PIT_CHANNEL0, (new_divisor >> 8) & 0xFF);
+    divisor = new_divisor;
+    frequency = PIT_BASE_FREQUENCY / new_divisor;
+    irq_restore(flags);
+}
+
+int timer_init(uint32_t hz) {
+    timer_set_frequency(hz);
+    tick_running = irq_register(TIMER_IRQ, timer_irq);
+    return tick_running;
+}
+
+uint32_t timer_frequency(void) {
+    return frequency;
+}
+
+// The counter is 64 bits wide, so read it with the tick held off
+uint64_t timer_ticks(void) {
+    uint32_t flags = irq_save();
+    uint64_t now = ticks;
+    irq_restore(flags);
+    return now;
+}
+
+uint32_t timer_uptime_seconds(void) {
+    if (!frequency) return 0;
+    return (uint32_t)(timer_ticks() / frequency);
+}
+
+uint64_t timer_uptime_ms(void) {
+    if (!frequency) return 0;
+    return timer_ticks() * 1000 / frequency;
+}
+
+// Current channel 0 count. In mode 2 it runs from the divisor down to 1;
+// a divisor of 65536 is loaded, and reads, as 0.
+static uint32_t pit_read_count(void) {
+    outb(PIT_COMMAND, PIT_CH0_LATCH);
+    uint32_t low = inb(PIT_CHANNEL0);
+    uint32_t high = inb(PIT_CHANNEL0);
+    uint32_t count = low | (high << 8);
+    return count ? count : 65536;
+}
+
+// PIT clocks since timer_init(). The count may already have wrapped while
+// IRQ 0 waits to be delivered; a pending IRQ together with a count in the
+// first half of the period means the tick is not in `ticks` yet.
+static uint64_t pit_clock(void) {
+    uint32_t flags = irq_save();
+    uint64_t now = ticks;
+    uint32_t elapsed = divisor - pit_read_count();
+    if (elapsed < divisor / 2 && irq_pending(TIMER_IRQ)) now++;
+    irq_restore(flags);
+    return now * divisor + elapsed;
+}
+
+static void sleep_clocks(uint64_t clocks) {
+    if (!divisor) return;
+    
+    if (tick_running && interrupts_enabled()) {
+        // The tick is running: halt through whole ticks, then spin out
+        // the last fraction
+        uint64_t deadline = pit_clock() + clocks;
+        uint64_t now;
+        while ((now = pit_clock()) < deadline) {
+            if (deadline - now > divisor) {
+                cpu_idle();
+            } else {
+                __asm__ volatile ("pause");
+            }
+        }
+        return;
+    }
+    
+    // No ticks are counted with interrupts off, so add up how far the
+    // counter moves between reads instead
+    uint32_t last = pit_read_count();
+    while (clocks > 0) {
+        __asm__ volatile ("pause");
+        uint32_t count = pit_read_count();
+        uint32_t moved = count <= last ? last - count : last + divisor - count;
+        if (moved >= clocks) break;
+        clocks -= moved;
+        last = count;
+    }
+}
+
+void ksleep_ms(uint32_t ms) {
+    sleep_clocks(((uint64_t)ms * PIT_BASE_FREQUENCY + 999) / 1000);
+}
+
+void ksleep_us(uint32_t us) {
+    sleep_clocks(((uint64_t)us * PIT_BASE_FREQUENCY + 999999) / 1000000);
+}
+
+// Ticks covering at least ms, and at least one
+static uint32_t ms_to_ticks(uint32_t ms) {
+    uint64_t count = ((uint64_t)ms * frequency + 999) / 1000;
+    return count ? (uint32_t)count : 1;
+}
+
+void timer_event_init(timer_event_t* event, timer_callback_t callback, void* data) {
+    event->next = event->prev = 0;
+    event->expires = 0;
+    event->period = 0;
+    event->callback = callback;
+    event->data = data;
+    event->pending = 0;
+}
+
+void timer_start(timer_event_t* event, uint32_t delay_ms, uint32_t period_ms) {
+    uint32_t flags = irq_save();
+    if (event->pending) wheel_unlink(event);
+    event->expires = ticks + ms_to_ticks(delay_ms);
+    event->period = period_ms ? ms_to_ticks(period_ms) : 0;
+    wheel_link(event);
+    irq_restore(flags);
+}
+
+int timer_cancel(timer_event_t* event) {
+    uint32_t flags = irq_save();
+    int was_pending = event->pending;
+    if (was_pending) wheel_unlink(event);
+    irq_restore(flags);
+    return was_pending;
+}
+
+void timer_dump_info(void) {
+    if (!frequency) {
+        kprintf("Timer: PIT not programmed\n");
+        return;
+    }
+    uint32_t seconds = timer_uptime_seconds();
+    kprintf("Timer: PIT at %u Hz, IRQ %d, %u ticks (up %uh %um %us)\n",
+            frequency, TIMER_IRQ, (unsigned int)timer_ticks(),
+            seconds / 3600, (seconds % 3600) / 60, seconds % 60);
+    kprintf("Timer wheel: %u slots, %u events pending\n", TIMER_WHEEL_SLOTS, events_pending);
+}
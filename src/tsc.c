@@ -0,0 +1,136 @@
+#include "tsc.h"
+#include "timer.h"
+#include "io.h"
+#include "interrupts.h"
+#include "hardware_detection.h"
+#include "kprintf.h"
+
+// PIT channel 2 is gated by port 0x61 and its output can be read back
+// there, so it can time a window without touching the channel 0 tick
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND 0x43
+#define PIT_CH2_ONE_SHOT 0xB0       // Channel 2, low then high byte, mode 0
+#define PORT_B 0x61
+#define PORT_B_GATE2 0x01
+#define PORT_B_SPEAKER 0x02
+#define PORT_B_OUT2 0x20
+#define PIT_POLL_LIMIT 1000000      // Port reads before giving up on OUT2 (~1 s)
+
+#define NS_SHIFT 24                 // Fraction bits of the ns-per-cycle factor
+
+static int present = 0;
+static int invariant = 0;
+static uint64_t frequency = 0;
+static uint32_t ns_mult = 0;        // (10^9 << NS_SHIFT) / frequency
+static uint64_t base_cycles = 0;
+
+uint64_t rdtsc(void) {
+    uint32_t low, high;
+    __asm__ volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// Cycles the TSC advances while channel 2 counts down `ms`; 0 if OUT2
+// never rises, as when channel 2 or port 0x61 is not emulated
+static uint64_t measure_window(uint32_t ms) {
+    uint32_t count = PIT_BASE_FREQUENCY * ms / 1000;
+    
+    // Gate off and speaker off while loading, so the count starts on the
+    // rising edge of the gate below
+    uint8_t port_b = inb(PORT_B) & ~(PORT_B_GATE2 | PORT_B_SPEAKER);
+    outb(PORT_B, port_b);
+    outb(PIT_COMMAND, PIT_CH2_ONE_SHOT);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+    
+    outb(PORT_B, port_b | PORT_B_GATE2);
+    uint64_t start = rdtsc();
+    int polls = 0;
+    while (!(inb(PORT_B) & PORT_B_OUT2) && polls < PIT_POLL_LIMIT) polls++;
+    uint64_t end = rdtsc();
+    
+    outb(PORT_B, port_b);
+    return polls < PIT_POLL_LIMIT ? end - start : 0;
+}
+
+int tsc_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    if (!cpu_has_cpuid()) return 0;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1 << 4))) return 0;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        invariant = (edx >> 8) & 1;
+    }
+    
+    // Interrupts off so that no handler stretches a window
+    uint64_t samples[TSC_CALIBRATE_RUNS];
+    uint32_t flags = irq_save();
+    int timed_out = 0;
+    for (int i = 0; i < TSC_CALIBRATE_RUNS && !timed_out; i++) {
+        samples[i] = measure_window(TSC_CALIBRATE_MS);
+        timed_out = samples[i] == 0;
+    }
+    irq_restore(flags);
+    
+    // No usable reference: stay on the PIT tick
+    if (timed_out) {
+        frequency = 0;
+        return 0;
+    }
+    
+    // Median, so one window hit by an SMI or a host preemption is ignored
+    for (int i = 1; i < TSC_CALIBRATE_RUNS; i++) {
+        for (int j = i; j > 0 && samples[j] < samples[j - 1]; j--) {
+            uint64_t swap = samples[j];
+            samples[j] = samples[j - 1];
+            samples[j - 1] = swap;
+        }
+    }
+    uint64_t cycles = samples[TSC_CALIBRATE_RUNS / 2];
+    uint32_t pit_count = PIT_BASE_FREQUENCY * TSC_CALIBRATE_MS / 1000;
+    frequency = cycles * PIT_BASE_FREQUENCY / pit_count;
+    
+    // Below a few MHz the multiplier would not fit in 32 bits
+    if (frequency < 4000000) {
+        frequency = 0;
+        return 0;
+    }
+    ns_mult = (uint32_t)((1000000000ULL << NS_SHIFT) / frequency);
+    base_cycles = rdtsc();
+    present = 1;
+    return 1;
+}
+
+int tsc_present(void) {
+    return present;
+}
+
+uint64_t tsc_frequency(void) {
+    return frequency;
+}
+
+// cycles * ns_mult >> NS_SHIFT without a 96-bit intermediate: multiply the
+// two 32-bit halves separately and recombine
+uint64_t tsc_cycles_to_ns(uint64_t cycles) {
+    uint64_t low = (uint64_t)(uint32_t)cycles * ns_mult;
+    uint64_t high = (cycles >> 32) * ns_mult;
+    return (high << (32 - NS_SHIFT)) + (low >> NS_SHIFT);
+}
+
+uint64_t ktime_ns(void) {
+    if (!present) return timer_uptime_ms() * 1000000;
+    return tsc_cycles_to_ns(rdtsc() - base_cycles);
+}
+
+void tsc_dump_info(void) {
+    if (!present) {
+        kprintf("TSC: not available, using the %u Hz PIT tick\n", timer_frequency());
+        return;
+    }
+    uint32_t khz = (uint32_t)(frequency / 1000);
+    kprintf("TSC: %u.%03u MHz (calibrated on PIT channel 2), %s\n",
+            khz / 1000, khz % 1000, invariant ? "invariant" : "may vary with power state");
+}